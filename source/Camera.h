@@ -36,6 +36,7 @@ namespace dae
 		float totalYaw{};
 
 		float nearPlane{ 0.1f }, farPlane{100.f};
+		bool isReverseZ{ false };
 
 		Matrix invViewMatrix{};
 		Matrix viewMatrix{};
@@ -65,7 +66,8 @@ namespace dae
 
 		void CalculateProjectionMatrix()
 		{
-			projectionMatrix = Matrix::CreatePerspectiveFovLH(fov, aspectRatio, nearPlane, farPlane);
+			if (isReverseZ) projectionMatrix = Matrix::CreatePerspectiveFovLHReverseZ(fov, aspectRatio, nearPlane, farPlane);
+			else projectionMatrix = Matrix::CreatePerspectiveFovLH(fov, aspectRatio, nearPlane, farPlane);
 		}
 
 		void Update(const Timer* pTimer)
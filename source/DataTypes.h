@@ -32,17 +32,20 @@ namespace dae
 		Vector3 normal;
 		Vector3 tangent;
 		Vector3 viewDirection;
+		float uvLod; // log2 of the uv extent of one pixel
 
-		static Vertex_Out Interpolate(const std::vector<Vertex_Out>& verts, float w0, float w1, float w2, bool shouldInterpolateDepth = false)
+		// Reads the triangle in place, the per pixel paths can't afford to gather it into a container first
+		static Vertex_Out Interpolate(const Vertex_Out& vert0, const Vertex_Out& vert1, const Vertex_Out& vert2, float w0, float w1, float w2, bool shouldInterpolateDepth = false)
 		{
+			const Vertex_Out* verts[3]{ &vert0, &vert1, &vert2 };
 			Vertex_Out interpolatedVertex;
 
 			const float interpolatedViewSpaceDepth
 			{
 				1.f / (
-					((1.f / verts[0].position.w) * w0) +
-					((1.f / verts[1].position.w) * w1) +
-					((1.f / verts[2].position.w) * w2)
+					((1.f / verts[0]->position.w) * w0) +
+					((1.f / verts[1]->position.w) * w1) +
+					((1.f / verts[2]->position.w) * w2)
 					)
 			};
 
@@ -51,9 +54,9 @@ namespace dae
 				interpolatedVertex.position.z =
 				{
 					(
-						((verts[0].position.z / verts[0].position.w) * w0) +
-						((verts[1].position.z / verts[1].position.w) * w1) +
-						((verts[2].position.z / verts[2].position.w) * w2)
+						((verts[0]->position.z / verts[0]->position.w) * w0) +
+						((verts[1]->position.z / verts[1]->position.w) * w1) +
+						((verts[2]->position.z / verts[2]->position.w) * w2)
 					) * interpolatedViewSpaceDepth
 				};
 
@@ -64,36 +67,36 @@ namespace dae
 			interpolatedVertex.uv =
 			{
 				(
-					((verts[0].uv / verts[0].position.w) * w0) +
-					((verts[1].uv / verts[1].position.w) * w1) +
-					((verts[2].uv / verts[2].position.w) * w2)
+					((verts[0]->uv / verts[0]->position.w) * w0) +
+					((verts[1]->uv / verts[1]->position.w) * w1) +
+					((verts[2]->uv / verts[2]->position.w) * w2)
 				) * interpolatedViewSpaceDepth
 			};
 
 			interpolatedVertex.normal =
 			{
 				((
-					((verts[0].normal / verts[0].position.w) * w0) +
-					((verts[1].normal / verts[1].position.w) * w1) +
-					((verts[2].normal / verts[2].position.w) * w2)
+					((verts[0]->normal / verts[0]->position.w) * w0) +
+					((verts[1]->normal / verts[1]->position.w) * w1) +
+					((verts[2]->normal / verts[2]->position.w) * w2)
 				) * interpolatedViewSpaceDepth)
 			};
 
 			interpolatedVertex.tangent =
 			{
 				((
-					((verts[0].tangent / verts[0].position.w) * w0) +
-					((verts[1].tangent / verts[1].position.w) * w1) +
-					((verts[2].tangent / verts[2].position.w) * w2)
+					((verts[0]->tangent / verts[0]->position.w) * w0) +
+					((verts[1]->tangent / verts[1]->position.w) * w1) +
+					((verts[2]->tangent / verts[2]->position.w) * w2)
 				) * interpolatedViewSpaceDepth)
 			};
 
 			interpolatedVertex.viewDirection =
 			{
 				((
-					((verts[0].viewDirection / verts[0].position.w) * w0) +
-					((verts[1].viewDirection / verts[1].position.w) * w1) +
-					((verts[2].viewDirection / verts[2].position.w) * w2)
+					((verts[0]->viewDirection / verts[0]->position.w) * w0) +
+					((verts[1]->viewDirection / verts[1]->position.w) * w1) +
+					((verts[2]->viewDirection / verts[2]->position.w) * w2)
 				) * interpolatedViewSpaceDepth)
 			};
 
@@ -110,6 +113,15 @@ namespace dae
 		SIZE = 3
 	};
 
+	enum class AddressMode
+	{
+		Wrap,
+		Mirror,
+		Clamp,
+
+		SIZE = 3
+	};
+
 	enum class RenderType
 	{
 		Hardware,
@@ -118,6 +130,54 @@ namespace dae
 		SIZE = 2
 	};
 
+	enum class RenderPipeline
+	{
+		Forward,
+		Deferred,
+		VisibilityBuffer,
+
+		SIZE = 3
+	};
+
+	enum class TransparencyMode
+	{
+		Ordered,
+		WeightedBlended,
+		SortedTiles,
+
+		SIZE = 3
+	};
+
+	// Width x height of the pixel block that shares one shaded color
+	enum class ShadingRate : uint8_t
+	{
+		Rate1x1,
+		Rate1x2,
+		Rate2x2,
+		Rate4x4
+	};
+
+	// Where the per tile shading rate comes from
+	enum class ShadingRatePolicy
+	{
+		Off,
+		LuminanceGradient,
+		Distance,
+		RateImage,
+
+		SIZE = 4
+	};
+
+	// Precision of the software depth buffer, D24 matches the hardware path's D24_UNORM_S8_UINT
+	enum class DepthFormat
+	{
+		D16,
+		D24,
+		D32,
+
+		SIZE = 3
+	};
+
 	struct RenderInfo
 	{
 		// Common variables
@@ -126,6 +186,8 @@ namespace dae
 		ColorRGB clearColor{};
 		bool doRotate{ true };
 		bool showFPS{ false };
+		AddressMode textureAddressMode{ AddressMode::Wrap };
+		bool useReverseZ{ false }; // Near plane at depth 1, far plane at 0, flips every depth test and clear
 
 		// Hardware variables
 		FilteringMode textureFiltering { FilteringMode::Point };
@@ -133,12 +195,22 @@ namespace dae
 
 		// Software variables
 		ShadingMode shadingMode{ ShadingMode::FinalColor };
+		RenderPipeline pipeline{ RenderPipeline::Forward };
+		bool useDepthPrepass		{ false };
+		TransparencyMode transparencyMode{ TransparencyMode::Ordered };
+		bool useMSAA				{ false };
+		ShadingRatePolicy shadingRatePolicy{ ShadingRatePolicy::Off };
+		bool useDynamicResolution	{ false };
+		bool useFramePipelining		{ false };
+		DepthFormat depthFormat{ DepthFormat::D32 };
 		bool useFastCulling			{ true  };
 		bool useClipping			{ true  };
 		bool useNormalMap			{ true  };
 		bool visualizeDepthBuffer	{ false };
 		bool visualizeBoundingBox	{ false };
 		bool useMultiThreading		{ true  };
+		bool useVirtualTexturing	{ false }; // Only read when the scene is initialized, set with --virtual-texturing
+		bool useFastShading			{ false };
 	};
 
 	struct Bounds
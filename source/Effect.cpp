@@ -40,28 +40,51 @@ dae::Effect::Effect(ID3D11Device* pDevice, const std::wstring& assetFile)
     rasterizer_desc.CullMode = D3D11_CULL_NONE;
     if (!SUCCEEDED(pDevice->CreateRasterizerState(&rasterizer_desc, &m_pNoCulling))) assert(-1);
 
-    m_pSampler = m_pEffect->GetVariableByName("gSampler")->AsSampler();
-    if (!m_pSampler->IsValid())
-        std::wcout << L"m_pSampler is not valid!\n";
+    m_pDepthStencil = m_pEffect->GetVariableByName("gDepthStencilState")->AsDepthStencil();
+    if (!m_pDepthStencil->IsValid())
+        std::wcout << L"m_pDepthStencil is not valid!\n";
 
-    D3D11_SAMPLER_DESC sampler_desc{};
-    sampler_desc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
-    sampler_desc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
-    sampler_desc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
-    sampler_desc.ComparisonFunc = D3D11_COMPARISON_NEVER;
-    sampler_desc.MipLODBias = 0;
-    sampler_desc.MinLOD = 0;
-    sampler_desc.MaxLOD = D3D11_FLOAT32_MAX;
-    sampler_desc.MaxAnisotropy = 16;
+    D3D11_DEPTH_STENCIL_DESC depth_stencil_desc{};
+    if (FAILED(m_pDepthStencil->GetBackingStore(0, &depth_stencil_desc))) assert(-1);
+    if (!SUCCEEDED(pDevice->CreateDepthStencilState(&depth_stencil_desc, &m_pDepthTest))) assert(-1);
 
-    sampler_desc.Filter = D3D11_FILTER_MIN_MAG_MIP_POINT;
-    if (!SUCCEEDED(pDevice->CreateSamplerState(&sampler_desc, &m_pPoint))) assert(-1);
+    switch (depth_stencil_desc.DepthFunc)
+    {
+    case D3D11_COMPARISON_LESS:             depth_stencil_desc.DepthFunc = D3D11_COMPARISON_GREATER; break;
+    case D3D11_COMPARISON_LESS_EQUAL:       depth_stencil_desc.DepthFunc = D3D11_COMPARISON_GREATER_EQUAL; break;
+    case D3D11_COMPARISON_GREATER:          depth_stencil_desc.DepthFunc = D3D11_COMPARISON_LESS; break;
+    case D3D11_COMPARISON_GREATER_EQUAL:    depth_stencil_desc.DepthFunc = D3D11_COMPARISON_LESS_EQUAL; break;
+    default: break;
+    }
+    if (!SUCCEEDED(pDevice->CreateDepthStencilState(&depth_stencil_desc, &m_pReverseDepthTest))) assert(-1);
 
-    sampler_desc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
-    if (!SUCCEEDED(pDevice->CreateSamplerState(&sampler_desc, &m_pLinear))) assert(-1);
+    m_pSampler = m_pEffect->GetVariableByName("gSampler")->AsSampler();
+    if (!m_pSampler->IsValid())
+        std::wcout << L"m_pSampler is not valid!\n";
 
-    sampler_desc.Filter = D3D11_FILTER_ANISOTROPIC;
-    if (!SUCCEEDED(pDevice->CreateSamplerState(&sampler_desc, &m_pAnisotropic))) assert(-1);
+    // Same order as AddressMode, matches the addressing of the software sampler
+    const D3D11_TEXTURE_ADDRESS_MODE address_modes[]{ D3D11_TEXTURE_ADDRESS_WRAP, D3D11_TEXTURE_ADDRESS_MIRROR, D3D11_TEXTURE_ADDRESS_CLAMP };
+    for (int i = 0; i < static_cast<int>(AddressMode::SIZE); ++i)
+    {
+        D3D11_SAMPLER_DESC sampler_desc{};
+        sampler_desc.AddressU = address_modes[i];
+        sampler_desc.AddressV = address_modes[i];
+        sampler_desc.AddressW = address_modes[i];
+        sampler_desc.ComparisonFunc = D3D11_COMPARISON_NEVER;
+        sampler_desc.MipLODBias = 0;
+        sampler_desc.MinLOD = 0;
+        sampler_desc.MaxLOD = D3D11_FLOAT32_MAX;
+        sampler_desc.MaxAnisotropy = 16;
+
+        sampler_desc.Filter = D3D11_FILTER_MIN_MAG_MIP_POINT;
+        if (!SUCCEEDED(pDevice->CreateSamplerState(&sampler_desc, &m_pPoint[i]))) assert(-1);
+
+        sampler_desc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+        if (!SUCCEEDED(pDevice->CreateSamplerState(&sampler_desc, &m_pLinear[i]))) assert(-1);
+
+        sampler_desc.Filter = D3D11_FILTER_ANISOTROPIC;
+        if (!SUCCEEDED(pDevice->CreateSamplerState(&sampler_desc, &m_pAnisotropic[i]))) assert(-1);
+    }
 
     LoadInputLayout(pDevice, m_pTechnique);
 }
@@ -69,11 +92,17 @@ dae::Effect::Effect(ID3D11Device* pDevice, const std::wstring& assetFile)
 dae::Effect::~Effect()
 {
     if (m_pInputLayout) m_pInputLayout->Release();
-    if (m_pAnisotropic) m_pAnisotropic->Release();
-    if (m_pLinear) m_pLinear->Release();
-    if (m_pPoint) m_pPoint->Release();
+    for (int i = 0; i < static_cast<int>(AddressMode::SIZE); ++i)
+    {
+        if (m_pAnisotropic[i]) m_pAnisotropic[i]->Release();
+        if (m_pLinear[i]) m_pLinear[i]->Release();
+        if (m_pPoint[i]) m_pPoint[i]->Release();
+    }
     if (m_pSampler) m_pSampler->Release();
     if (m_pNoCulling) m_pNoCulling->Release();
+    if (m_pReverseDepthTest) m_pReverseDepthTest->Release();
+    if (m_pDepthTest) m_pDepthTest->Release();
+    if (m_pDepthStencil) m_pDepthStencil->Release();
     if (m_pFrontFaceCulling) m_pFrontFaceCulling->Release();
     if (m_pBackFaceCulling) m_pBackFaceCulling->Release();
     if (m_pRasterizer) m_pRasterizer->Release();
@@ -184,16 +213,28 @@ ID3D11InputLayout* dae::Effect::LoadInputLayout(ID3D11Device* pDevice, ID3DX11Ef
 
 void dae::Effect::SetTextureFiltering(const FilteringMode& mode)
 {
-    switch (mode)
+    m_FilteringMode = mode;
+    ApplySampler();
+}
+
+void dae::Effect::SetTextureAddressMode(const AddressMode& mode)
+{
+    m_AddressMode = mode;
+    ApplySampler();
+}
+
+void dae::Effect::ApplySampler()
+{
+    switch (m_FilteringMode)
     {
     case dae::FilteringMode::Point:
-        m_pSampler->SetSampler(0, m_pPoint);
+        m_pSampler->SetSampler(0, m_pPoint[static_cast<int>(m_AddressMode)]);
         break;
     case dae::FilteringMode::Linear:
-        m_pSampler->SetSampler(0, m_pLinear);
+        m_pSampler->SetSampler(0, m_pLinear[static_cast<int>(m_AddressMode)]);
         break;
     case dae::FilteringMode::Anisotropic:
-        m_pSampler->SetSampler(0, m_pAnisotropic);
+        m_pSampler->SetSampler(0, m_pAnisotropic[static_cast<int>(m_AddressMode)]);
         break;
     }
 }
@@ -217,6 +258,11 @@ void dae::Effect::SetCullMode(const CullMode& mode)
     }
 }
 
+void dae::Effect::SetReverseZ(bool isReverseZ)
+{
+    m_pDepthStencil->SetDepthStencilState(0, isReverseZ ? m_pReverseDepthTest : m_pDepthTest);
+}
+
 void dae::Effect::SetWorldMatrix(const Matrix& worldMatrix)
 {
     m_pWorldMat->SetMatrix(reinterpret_cast<const float*>(&worldMatrix));
@@ -4,12 +4,15 @@ namespace dae
 {
 	class Texture;
 	enum class FilteringMode;
+	enum class AddressMode;
 	enum class CullMode;
 
 	enum class EffectType
 	{
 		Diffuse,
-		Transparent
+		Transparent,
+
+		SIZE = 2
 	};
 
 	class Effect
@@ -28,7 +31,9 @@ namespace dae
 
 		// Setters
 		void SetTextureFiltering(const FilteringMode& mode);
+		void SetTextureAddressMode(const AddressMode& mode);
 		void SetCullMode(const CullMode& mode);
+		void SetReverseZ(bool isReverseZ);
 
 		void SetWorldMatrix(const Matrix& worldMatrix);
 		void SetViewInverseMatrix(const Matrix& inverseViewMatrix);
@@ -58,11 +63,20 @@ namespace dae
 		ID3D11RasterizerState* m_pBackFaceCulling{};
 		ID3D11RasterizerState* m_pNoCulling{};
 
-		// Samplers
+		// Depth test as declared in the effect file, and the same test flipped for reverse-Z
+		ID3DX11EffectDepthStencilVariable* m_pDepthStencil{};
+		ID3D11DepthStencilState* m_pDepthTest{};
+		ID3D11DepthStencilState* m_pReverseDepthTest{};
+
+		// Samplers, one per address mode (Wrap/Mirror/Clamp)
 		ID3DX11EffectSamplerVariable* m_pSampler{};
-		ID3D11SamplerState* m_pPoint{};
-		ID3D11SamplerState* m_pLinear{};
-		ID3D11SamplerState* m_pAnisotropic{};
+		ID3D11SamplerState* m_pPoint[3]{};
+		ID3D11SamplerState* m_pLinear[3]{};
+		ID3D11SamplerState* m_pAnisotropic[3]{};
+		FilteringMode m_FilteringMode{};
+		AddressMode m_AddressMode{};
+
+		void ApplySampler();
 	};
 
 	class EffectPosTex final : public Effect
@@ -0,0 +1,124 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <cassert>
+#include "Vector3.h"
+
+namespace dae
+{
+	// Approximations for the hot spots of the software shader, used when RenderInfo::useFastShading is set.
+	// Pow is built as exp2(y * log2(x)) from two degree 4 polynomials on the mantissa/fraction,
+	// which stays within 0.1% of powf (see MaxPowError) for the gloss exponents the shader uses.
+	namespace FastMath
+	{
+		inline float Log2(float x)
+		{
+			// x = 2^e * (1 + t), log2(x) = e + t * p(t) with t in [0, 1)
+			uint32_t bits;
+			std::memcpy(&bits, &x, sizeof(float));
+			const float e{ static_cast<float>(static_cast<int>(bits >> 23) - 127) };
+
+			bits = (bits & 0x007FFFFF) | 0x3F800000;
+			float m;
+			std::memcpy(&m, &bits, sizeof(float));
+			const float t{ m - 1.f };
+
+			const float p{ 1.44261568f + t * (-0.71706393f + t * (0.44227418f + t * (-0.22771264f + t * 0.05994559f))) };
+			return e + t * p;
+		}
+
+		inline float Exp2(float x)
+		{
+			// 2^x = 2^i * 2^f, the integer part goes straight into the exponent bits
+			x = std::clamp(x, -126.f, 127.f);
+			const float i{ std::floor(x) };
+			const float f{ x - i };
+
+			const float p{ 1.00000252f + f * (0.69300662f + f * (0.24142749f + f * (0.05203743f + f * 0.01352060f))) };
+
+			const uint32_t scaleBits{ static_cast<uint32_t>(static_cast<int>(i) + 127) << 23 };
+			float scale;
+			std::memcpy(&scale, &scaleBits, sizeof(float));
+			return p * scale;
+		}
+
+		// Only valid for x >= 0, which is all the specular term ever passes in
+		inline float Pow(float x, float y)
+		{
+			if (x <= 0.f) return y == 0.f ? 1.f : 0.f;
+			return Exp2(y * Log2(x));
+		}
+
+		inline float Rsqrt(float x)
+		{
+			// Bit level initial guess refined with one Newton-Raphson step
+			uint32_t bits;
+			std::memcpy(&bits, &x, sizeof(float));
+			bits = 0x5F375A86 - (bits >> 1);
+			float y;
+			std::memcpy(&y, &bits, sizeof(float));
+			return y * (1.5f - 0.5f * x * y * y);
+		}
+
+		inline void Normalize(Vector3& v)
+		{
+			const float sqrMagnitude{ v.SqrMagnitude() };
+			if (sqrMagnitude <= 0.f) return;
+
+			const float invMagnitude{ Rsqrt(sqrMagnitude) };
+			v.x *= invMagnitude;
+			v.y *= invMagnitude;
+			v.z *= invMagnitude;
+		}
+
+		// Relative error bounds the approximations are held to, they currently measure 9.4e-4 for pow and 1.75e-3 for rsqrt
+		inline constexpr float MaxPowError{ 1e-3f };
+		inline constexpr float MaxRsqrtError{ 2e-3f };
+
+		struct AccuracyReport
+		{
+			float maxPowError;
+			float maxRsqrtError;
+		};
+
+		// Compares the approximations against the standard library over the range the shader uses them in
+		// (cos angle in [0, 1], exponent in [0, 25] for pow). Both errors are relative, for pow against at least 1e-3
+		// since the results below that don't show up in a color channel anyway
+		inline AccuracyReport MeasureAccuracy()
+		{
+			AccuracyReport report{};
+
+			for (int i = 0; i <= 256; ++i)
+			{
+				const float cosAngle{ static_cast<float>(i) / 256.f };
+				for (int j = 0; j <= 100; ++j)
+				{
+					const float exponent{ static_cast<float>(j) * 0.25f };
+					const float reference{ std::pow(cosAngle, exponent) };
+					const float error{ std::abs(Pow(cosAngle, exponent) - reference) / std::max(reference, 1e-3f) };
+					report.maxPowError = std::max(report.maxPowError, error);
+				}
+			}
+
+			for (int i = 1; i <= 4096; ++i)
+			{
+				const float x{ static_cast<float>(i) / 256.f };
+				const float reference{ 1.f / std::sqrt(x) };
+				report.maxRsqrtError = std::max(report.maxRsqrtError, std::abs(Rsqrt(x) - reference) / reference);
+			}
+
+			return report;
+		}
+
+		// Fails in debug builds when an approximation drifts past its bound
+		inline AccuracyReport CheckAccuracy()
+		{
+			const AccuracyReport report{ MeasureAccuracy() };
+			assert(report.maxPowError < MaxPowError && "ERROR: FastMath::Pow is less accurate than MaxPowError!");
+			assert(report.maxRsqrtError < MaxRsqrtError && "ERROR: FastMath::Rsqrt is less accurate than MaxRsqrtError!");
+			return report;
+		}
+	}
+}
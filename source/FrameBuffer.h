@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+#include <new>
+
+namespace dae
+{
+	// Per pixel software storage laid out tile-major: every tileSize x tileSize tile is one contiguous block with rows
+	// of tileSize elements, edge tiles are padded to the full size. Blocks start on a cache line, so threads working
+	// on different tiles never share one, and a whole tile can be cleared or scanned as a single run.
+	// Tiles are numbered row by row like the renderer's tile jobs, elementsPerPixel keeps the samples of a pixel together.
+	template<typename T, int tileSize>
+	class FrameBuffer final
+	{
+	public:
+		FrameBuffer() = default;
+		~FrameBuffer()
+		{
+			::operator delete[](m_pData, std::align_val_t{ m_Alignment });
+		}
+
+		FrameBuffer(const FrameBuffer&) = delete;
+		FrameBuffer(FrameBuffer&&) noexcept = delete;
+		FrameBuffer& operator=(const FrameBuffer&) = delete;
+		FrameBuffer& operator=(FrameBuffer&&) noexcept = delete;
+
+		// Allocates for the largest size the buffer is used at, smaller sizes reuse the storage through SetWidth
+		void Allocate(int maxWidth, int maxHeight, uint32_t elementsPerPixel = 1)
+		{
+			static_assert(tileSize * tileSize * sizeof(T) % m_Alignment == 0, "Tiles have to be a multiple of a cache line");
+
+			const size_t numTiles{ static_cast<size_t>((maxWidth + tileSize - 1) / tileSize) * ((maxHeight + tileSize - 1) / tileSize) };
+			m_ElementsPerPixel = elementsPerPixel;
+			m_pData = static_cast<T*>(::operator new[](numTiles * m_ElementsPerTile * elementsPerPixel * sizeof(T), std::align_val_t{ m_Alignment }));
+			SetWidth(maxWidth);
+		}
+
+		// The tile grid follows the render width, the tiles themselves keep their size
+		void SetWidth(int width) { m_NumTilesX = static_cast<uint32_t>((width + tileSize - 1) / tileSize); }
+
+		// Element index of a pixel, multiply by elementsPerPixel for the first element of multi element pixels
+		uint32_t GetIndex(uint32_t px, uint32_t py) const
+		{
+			const uint32_t tile{ px / tileSize + (py / tileSize) * m_NumTilesX };
+			return tile * m_ElementsPerTile + (py % tileSize) * tileSize + px % tileSize;
+		}
+
+		// Same as GetIndex for a pixel of a known tile, without the divisions
+		static uint32_t GetIndexInTile(uint32_t tileIndex, uint32_t localX, uint32_t localY)
+		{
+			return tileIndex * m_ElementsPerTile + localY * tileSize + localX;
+		}
+
+		T* GetTile(uint32_t tile) const { return m_pData + static_cast<size_t>(tile) * m_ElementsPerTile * m_ElementsPerPixel; }
+		static constexpr uint32_t GetElementsPerTile() { return m_ElementsPerTile; }
+
+		// Like the raw pixel pointers, const only protects the layout, not the pixels
+		T* GetData() const { return m_pData; }
+		T& operator[](uint32_t index) const { return m_pData[index]; }
+
+	private:
+		static constexpr size_t m_Alignment{ 64 };
+		static constexpr uint32_t m_ElementsPerTile{ tileSize * tileSize };
+
+		T* m_pData{ nullptr };
+		uint32_t m_NumTilesX{};
+		uint32_t m_ElementsPerPixel{ 1 };
+	};
+}
@@ -0,0 +1,250 @@
+#include "pch.h"
+#include "JobSystem.h"
+
+#if defined(__linux__)
+#include <pthread.h>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define USE_SSE2
+#endif
+
+namespace dae
+{
+	// The pool the current thread works for and the deque it owns
+	static thread_local const JobSystem* t_pJobSystem{ nullptr };
+	static thread_local uint32_t t_QueueIndex{ 0 };
+
+	JobSystem::JobSystem(uint32_t numWorkers, bool pinWorkers)
+	{
+		if (numWorkers == 0)
+			numWorkers = std::max(2u, std::thread::hardware_concurrency()) - 1;
+
+		m_Queues.reserve(numWorkers + 1);
+		for (uint32_t i{ 0 }; i <= numWorkers; ++i)
+			m_Queues.push_back(std::make_unique<JobQueue>());
+
+		m_Workers.reserve(numWorkers);
+		for (uint32_t i{ 0 }; i < numWorkers; ++i)
+			m_Workers.emplace_back(&JobSystem::WorkerLoop, this, i, pinWorkers);
+	}
+
+	JobSystem::~JobSystem()
+	{
+		{
+			std::lock_guard lock{ m_SleepMutex };
+			m_IsStopping = true;
+		}
+		m_SleepCondition.notify_all();
+
+		// Workers drain the remaining jobs before exiting
+		for (auto& worker : m_Workers)
+			worker.join();
+	}
+
+	void JobSystem::Submit(std::function<void()> job, JobCounter* pCounter, JobCounter* pDependency)
+	{
+		if (pCounter)
+			pCounter->m_NumPending.fetch_add(1, std::memory_order_relaxed);
+
+		if (pDependency)
+		{
+			// Checked under the lock the last job of the dependency takes to release its continuations
+			std::lock_guard lock{ pDependency->m_Mutex };
+			if (pDependency->m_NumPending.load(std::memory_order_acquire) > 0)
+			{
+				pDependency->m_Continuations.emplace_back(std::move(job), pCounter);
+				return;
+			}
+		}
+
+		Push(Job{ std::move(job), pCounter });
+	}
+
+	void JobSystem::Wait(JobCounter& counter)
+	{
+		uint32_t idleRounds{ 0 };
+		while (!counter.IsDone())
+		{
+			Job job{};
+			if (TryPop(job))
+			{
+				Execute(job);
+				idleRounds = 0;
+			}
+			else
+				Backoff(idleRounds++);
+		}
+
+		// The thread that ran the last job may still be releasing the counter's lock
+		std::lock_guard lock{ counter.m_Mutex };
+	}
+
+	void JobSystem::WorkerLoop(uint32_t workerIndex, bool pinWorker)
+	{
+		t_pJobSystem = this;
+		t_QueueIndex = workerIndex;
+
+		if (pinWorker)
+			PinCurrentThread((workerIndex + 1) % std::max(1u, std::thread::hardware_concurrency()));
+
+		// Idle workers spin a little before they sleep, the tile passes of a frame come in quick bursts
+		constexpr uint32_t maxIdleSpins{ 8 };
+		uint32_t idleRounds{ 0 };
+		while (true)
+		{
+			Job job{};
+			if (TryPop(job))
+			{
+				Execute(job);
+				idleRounds = 0;
+				continue;
+			}
+
+			if (idleRounds < maxIdleSpins && !m_IsStopping)
+			{
+				Backoff(idleRounds++);
+				continue;
+			}
+			idleRounds = 0;
+
+			// Registering as a sleeper before checking for jobs pairs with Push adding a job before checking for sleepers,
+			// one of the two always sees the other so the wake up can't get lost
+			std::unique_lock lock{ m_SleepMutex };
+			m_NumSleepers.fetch_add(1);
+			m_SleepCondition.wait(lock, [this]() { return m_IsStopping || m_NumQueuedJobs.load() > 0; });
+			m_NumSleepers.fetch_sub(1);
+
+			if (m_IsStopping && m_NumQueuedJobs.load() == 0)
+				return;
+		}
+	}
+
+	void JobSystem::Push(Job&& job)
+	{
+		JobQueue& queue{ *m_Queues[GetQueueIndex()] };
+		{
+			std::lock_guard lock{ queue.mutex };
+			queue.jobs.push_back(std::move(job));
+			queue.numJobs.fetch_add(1, std::memory_order_relaxed);
+		}
+		m_NumQueuedJobs.fetch_add(1);
+
+		if (m_NumSleepers.load() == 0)
+			return;
+
+		// Taking the lock orders this with a worker that is about to sleep, so the wake up can't get lost
+		{
+			std::lock_guard lock{ m_SleepMutex };
+		}
+		m_SleepCondition.notify_one();
+	}
+
+	bool JobSystem::TryPop(Job& job)
+	{
+		// Nothing queued anywhere, don't touch a single deque
+		if (m_NumQueuedJobs.load(std::memory_order_relaxed) == 0)
+			return false;
+
+		const uint32_t numQueues{ static_cast<uint32_t>(m_Queues.size()) };
+		const uint32_t ownIndex{ GetQueueIndex() };
+
+		// Newest job of our own deque first, it is the most likely to still be in cache
+		{
+			JobQueue& queue{ *m_Queues[ownIndex] };
+			if (queue.numJobs.load(std::memory_order_relaxed) > 0)
+			{
+				std::lock_guard lock{ queue.mutex };
+				if (!queue.jobs.empty())
+				{
+					job = std::move(queue.jobs.back());
+					queue.jobs.pop_back();
+					queue.numJobs.fetch_sub(1, std::memory_order_relaxed);
+					m_NumQueuedJobs.fetch_sub(1);
+					return true;
+				}
+			}
+		}
+
+		// Steal the oldest job of another deque, starting next to our own so thieves spread out.
+		// Only deques that look non-empty get locked
+		for (uint32_t offset{ 1 }; offset < numQueues; ++offset)
+		{
+			JobQueue& queue{ *m_Queues[(ownIndex + offset) % numQueues] };
+			if (queue.numJobs.load(std::memory_order_relaxed) == 0)
+				continue;
+
+			std::lock_guard lock{ queue.mutex };
+			if (!queue.jobs.empty())
+			{
+				job = std::move(queue.jobs.front());
+				queue.jobs.pop_front();
+				queue.numJobs.fetch_sub(1, std::memory_order_relaxed);
+				m_NumQueuedJobs.fetch_sub(1);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void JobSystem::Execute(Job& job)
+	{
+		job.func();
+
+		if (!job.pCounter)
+			return;
+
+		std::vector<std::pair<std::function<void()>, JobCounter*>> continuations{};
+		{
+			std::lock_guard lock{ job.pCounter->m_Mutex };
+			if (job.pCounter->m_NumPending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				continuations.swap(job.pCounter->m_Continuations);
+		}
+
+		for (auto& [func, pCounter] : continuations)
+			Push(Job{ std::move(func), pCounter });
+	}
+
+	uint32_t JobSystem::GetQueueIndex() const
+	{
+		return t_pJobSystem == this ? t_QueueIndex : static_cast<uint32_t>(m_Queues.size() - 1);
+	}
+
+	void JobSystem::Backoff(uint32_t idleRounds)
+	{
+		constexpr uint32_t maxSpinRounds{ 6 };
+		if (idleRounds >= maxSpinRounds)
+		{
+			std::this_thread::yield();
+			return;
+		}
+
+		for (uint32_t i{ 0 }; i < (1u << idleRounds); ++i)
+		{
+#ifdef USE_SSE2
+			_mm_pause();
+#endif
+		}
+	}
+
+	void JobSystem::PinCurrentThread(uint32_t hardwareThread)
+	{
+#if defined(_WIN32)
+		// Windows only schedules a thread within one processor group of up to 64 logical processors,
+		// spreading the workers over the groups is what lets the pool use more than 64 of them
+		GROUP_AFFINITY affinity{};
+		affinity.Group = static_cast<WORD>(hardwareThread / 64);
+		affinity.Mask = static_cast<KAFFINITY>(1) << (hardwareThread % 64);
+		SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr);
+#elif defined(__linux__)
+		cpu_set_t cpuSet;
+		CPU_ZERO(&cpuSet);
+		CPU_SET(hardwareThread, &cpuSet);
+		pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuSet);
+#else
+		(void)hardwareThread;
+#endif
+	}
+}
@@ -0,0 +1,140 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dae
+{
+	class JobSystem;
+
+	// Counts the unfinished jobs submitted with it. Jobs submitted with a counter as their dependency
+	// are held back until it reaches zero. A counter must outlive its jobs and the ones depending on it.
+	class JobCounter final
+	{
+	public:
+		JobCounter() = default;
+		~JobCounter() = default;
+
+		JobCounter(const JobCounter&) = delete;
+		JobCounter(JobCounter&&) noexcept = delete;
+		JobCounter& operator=(const JobCounter&) = delete;
+		JobCounter& operator=(JobCounter&&) noexcept = delete;
+
+		bool IsDone() const { return m_NumPending.load(std::memory_order_acquire) == 0; }
+
+	private:
+		friend class JobSystem;
+
+		std::atomic<uint32_t> m_NumPending{ 0 };
+
+		// Also taken for every decrement, so the counter is never touched after Wait returns
+		std::mutex m_Mutex{};
+		std::vector<std::pair<std::function<void()>, JobCounter*>> m_Continuations{};
+	};
+
+	// Work-stealing pool: every worker pushes and pops jobs on the back of its own deque and steals from the
+	// front of the others when it runs dry. Threads outside the pool submit to one shared deque, and a thread
+	// that waits on a counter runs jobs itself instead of blocking, so nested ParallelFor calls can't deadlock.
+	class JobSystem final
+	{
+	public:
+		// 0 workers = one worker per hardware thread, minus the main thread.
+		// Pinning gives worker i hardware thread i + 1, leaving the first one to the main thread.
+		JobSystem(uint32_t numWorkers = 0, bool pinWorkers = false);
+		~JobSystem();
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem(JobSystem&&) noexcept = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+		JobSystem& operator=(JobSystem&&) noexcept = delete;
+
+		void Submit(std::function<void()> job, JobCounter* pCounter = nullptr, JobCounter* pDependency = nullptr);
+
+		// For one-off tasks with a result, like asset loading
+		template<typename Func>
+		auto SubmitTask(Func&& func) -> std::future<std::invoke_result_t<Func>>
+		{
+			// std::function needs a copyable callable, so the task itself lives in a shared_ptr
+			auto pTask{ std::make_shared<std::packaged_task<std::invoke_result_t<Func>()>>(std::forward<Func>(func)) };
+			auto future{ pTask->get_future() };
+			Submit([pTask]() { (*pTask)(); });
+			return future;
+		}
+
+		// Runs jobs on the calling thread until the counter reaches zero
+		void Wait(JobCounter& counter);
+
+		// Calls func(i) for every i in [begin, end), split in batches of at least grainSize indices.
+		// Returns once every index is done, the calling thread takes part in the work.
+		template<typename Index, typename Func>
+		void ParallelFor(Index begin, Index end, const Func& func, Index grainSize = 1)
+		{
+			if (end <= begin) return;
+
+			// A few batches per worker so stealing can even out uneven batches
+			const Index count{ end - begin };
+			const Index numBatches{ static_cast<Index>(std::max<size_t>(1, std::min<size_t>(count / std::max<Index>(grainSize, 1), GetNumThreads() * 4))) };
+			const Index batchSize{ (count + numBatches - 1) / numBatches };
+
+			JobCounter counter{};
+			for (Index batchBegin{ begin }; batchBegin < end; batchBegin += batchSize)
+			{
+				const Index batchEnd{ std::min<Index>(batchBegin + batchSize, end) };
+				Submit([&func, batchBegin, batchEnd]()
+				{
+					for (Index i{ batchBegin }; i < batchEnd; ++i)
+						func(i);
+				}, &counter);
+			}
+			Wait(counter);
+		}
+
+		uint32_t GetNumWorkers() const { return static_cast<uint32_t>(m_Workers.size()); }
+		// Workers plus the thread that waits
+		uint32_t GetNumThreads() const { return GetNumWorkers() + 1; }
+
+	private:
+		struct Job
+		{
+			std::function<void()> func;
+			JobCounter* pCounter;
+		};
+
+		struct JobQueue
+		{
+			std::mutex mutex{};
+			std::deque<Job> jobs{};
+			// Mirrors jobs.size(), so thieves can skip an empty deque without taking its lock
+			std::atomic<uint32_t> numJobs{ 0 };
+		};
+
+		void WorkerLoop(uint32_t workerIndex, bool pinWorker);
+		void Push(Job&& job);
+		bool TryPop(Job& job);
+		void Execute(Job& job);
+
+		uint32_t GetQueueIndex() const;
+		static void PinCurrentThread(uint32_t hardwareThread);
+		// Pause spins that double with every idle round, the scheduler takes over once they get long
+		static void Backoff(uint32_t idleRounds);
+
+		std::vector<std::thread> m_Workers{};
+
+		// One deque per worker, the last one is shared by every thread outside the pool
+		std::vector<std::unique_ptr<JobQueue>> m_Queues{};
+
+		std::atomic<uint32_t> m_NumQueuedJobs{ 0 };
+		// Pushing only takes the sleep lock and notifies when a worker sleeps
+		std::atomic<uint32_t> m_NumSleepers{ 0 };
+		std::mutex m_SleepMutex{};
+		std::condition_variable m_SleepCondition{};
+		std::atomic<bool> m_IsStopping{ false };
+	};
+}
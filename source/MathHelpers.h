@@ -57,6 +57,12 @@ namespace dae
 		return v;
 	}
 
+	inline int FloorToInt(float v)
+	{
+		const int i{ static_cast<int>(v) };
+		return i - (v < static_cast<float>(i));
+	}
+
 	inline float Remap(float v, const float min, const float max)
 	{
 		v = std::clamp(v, min, max);
@@ -168,6 +168,18 @@ namespace dae {
 		};
 	}
 
+	Matrix Matrix::CreatePerspectiveFovLHReverseZ(float fov, float aspect, float zn, float zf)
+	{
+		const float invSubZnZf{ 1.f / (zn - zf) };
+		return
+		{
+			{1.f / (aspect * fov), 0.f, 0.f, 0.f},
+			{0.f, 1.f / fov, 0.f, 0.f},
+			{0.f, 0.f, zn * invSubZnZf, 1.f},
+			{0.f, 0.f, -(zf * zn) * invSubZnZf, 0.f}
+		};
+	}
+
 	Vector3 Matrix::GetAxisX() const
 	{
 		return data[0];
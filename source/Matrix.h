@@ -50,6 +50,8 @@ namespace dae {
 
 		static Matrix CreateLookAtLH(const Vector3& origin, const Vector3& forward, const Vector3& up);
 		static Matrix CreatePerspectiveFovLH(float fovy, float aspect, float zn, float zf);
+		// Maps the near plane to depth 1 and the far plane to 0, float depth then keeps its precision far away
+		static Matrix CreatePerspectiveFovLHReverseZ(float fovy, float aspect, float zn, float zf);
 
 		Vector4& operator[](int index);
 		Vector4 operator[](int index) const;
@@ -7,8 +7,8 @@ namespace dae
 #pragma warning( disable : 26495) // Uninit bla bla
 	dae::Mesh::Mesh(ID3D11Device* pDevice, const std::vector<Vertex_In>& vertices, const std::vector<uint32_t>& indices)
 		: m_IsEnabled(true)
-		, m_VerticesIn(vertices)
-		, m_Indices(indices)
+		, m_pIndices(std::make_shared<const std::vector<uint32_t>>(indices))
+		, m_pVerticesIn(std::make_shared<const std::vector<Vertex_In>>(vertices))
 	{
 
 		// Create vertex buffer
@@ -58,14 +58,35 @@ namespace dae
 		m_TranslationMatrix = other.m_TranslationMatrix;
 		m_RotationMatrix = other.m_RotationMatrix;
 
-		m_Indices = other.m_Indices;
-		m_VerticesIn = other.m_VerticesIn;
+		m_pIndices = other.m_pIndices;
+		m_pVerticesIn = other.m_pVerticesIn;
 		m_VerticesOut = other.m_VerticesOut;
 
 		m_pEffect = other.m_pEffect;
 	}
 #pragma warning ( pop )
 
+	void Mesh::CopyFrameState(const Mesh& other)
+	{
+		m_IsEnabled = other.m_IsEnabled;
+		m_PrimitiveTopology = other.m_PrimitiveTopology;
+		m_CullMode = other.m_CullMode;
+
+		m_pDiffuseMap = other.m_pDiffuseMap;
+		m_pNormalMap = other.m_pNormalMap;
+		m_pSpecularMap = other.m_pSpecularMap;
+		m_pGlossMap = other.m_pGlossMap;
+
+		m_WorldMatrix = other.m_WorldMatrix;
+		m_TranslationMatrix = other.m_TranslationMatrix;
+		m_RotationMatrix = other.m_RotationMatrix;
+
+		m_pIndices = other.m_pIndices;
+		m_pVerticesIn = other.m_pVerticesIn;
+
+		m_pEffect = other.m_pEffect;
+	}
+
 	dae::Mesh::~Mesh()
 	{
 		if(m_pIndexBuffer) m_pIndexBuffer->Release();
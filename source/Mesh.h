@@ -33,26 +33,30 @@ namespace dae
 		void SetSpecularMap(std::shared_ptr<Texture> pSpecular) { m_pSpecularMap = pSpecular; }
 		void SetGlossMap(std::shared_ptr<Texture> pGloss) { m_pGlossMap = pGloss; }
 
-		void SetVerticesOut(std::vector<Vertex_Out> verticesOut) { m_VerticesOut = verticesOut; }
-		void SetIndices(std::vector<uint32_t> indices) { m_Indices = indices; }
+		void SetVerticesOut(std::vector<Vertex_Out> verticesOut) { m_VerticesOut = std::move(verticesOut); }
+		void SetIndices(std::vector<uint32_t> indices) { m_pIndices = std::make_shared<const std::vector<uint32_t>>(std::move(indices)); }
+
+		// Takes over everything of other that can change from frame to frame, the geometry gets shared and the
+		// projected vertices stay, so a mesh reused as a frame snapshot keeps its buffers
+		void CopyFrameState(const Mesh& other);
 
 		// Getters
 		bool IsEnabled() const { return m_IsEnabled; }
 		PrimitiveTopology GetPrimitiveTopology() const { return m_PrimitiveTopology; }
 		CullMode GetCullMode() const { return m_CullMode; }
 
-		std::shared_ptr<Texture> GetDiffuseMap() const { return m_pDiffuseMap; }
-		std::shared_ptr<Texture> GetNormalMap() const { return m_pNormalMap; }
-		std::shared_ptr<Texture> GetSpecularMap() const { return m_pSpecularMap; }
-		std::shared_ptr<Texture> GetGlossMap() const { return m_pGlossMap; }
+		const std::shared_ptr<Texture>& GetDiffuseMap() const { return m_pDiffuseMap; }
+		const std::shared_ptr<Texture>& GetNormalMap() const { return m_pNormalMap; }
+		const std::shared_ptr<Texture>& GetSpecularMap() const { return m_pSpecularMap; }
+		const std::shared_ptr<Texture>& GetGlossMap() const { return m_pGlossMap; }
 
 		Matrix GetWorldMatrix() const { return m_WorldMatrix; }
 
-		std::vector<uint32_t> GetIndices() const { return m_Indices; }
-		std::vector<Vertex_In> GetVerticesIn() const { return m_VerticesIn; }
+		const std::vector<uint32_t>& GetIndices() const { return *m_pIndices; }
+		const std::vector<Vertex_In>& GetVerticesIn() const { return *m_pVerticesIn; }
 		std::vector<Vertex_Out>& GetVerticesOut() { return m_VerticesOut; }
 
-		std::shared_ptr<Effect> GetEffect() const { return m_pEffect; }
+		const std::shared_ptr<Effect>& GetEffect() const { return m_pEffect; }
 
 	private:
 		// Common
@@ -71,15 +75,15 @@ namespace dae
 		Matrix m_TranslationMatrix;
 		Matrix m_RotationMatrix;
 
-		// Software
-		std::vector<uint32_t> m_Indices;
-		std::vector<Vertex_In> m_VerticesIn;
+		// Software, the geometry never changes after loading so copies share it
+		std::shared_ptr<const std::vector<uint32_t>> m_pIndices{};
+		std::shared_ptr<const std::vector<Vertex_In>> m_pVerticesIn{};
 		std::vector<Vertex_Out> m_VerticesOut;
 
 		// DirectX
-		ID3D11Buffer* m_pVertexBuffer;
-		ID3D11Buffer* m_pIndexBuffer;
-		uint32_t m_NumIndices;
+		ID3D11Buffer* m_pVertexBuffer{};
+		ID3D11Buffer* m_pIndexBuffer{};
+		uint32_t m_NumIndices{};
 
 		std::shared_ptr<Effect> m_pEffect;
 	};
@@ -2,419 +2,1800 @@
 #include "Renderer.h"
 #include "Utils.h"
 #include "Scene.h"
-#include <ppl.h>
+#include "JobSystem.h"
+#include <numeric>
+#include <bit>
+#include <type_traits>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define USE_SSE2
+#endif
+
+namespace
+{
+	// Fills a run of pixel values 16 bytes at a time, streaming stores skip the cache for pixels nothing reads back soon.
+	// Values that don't divide 16 bytes, like 12 byte colors, repeat as a pattern of a few 16 byte stores
+	template<bool isStreaming, typename T>
+	void FillPixels(T* pPixels, int count, const T& value)
+	{
+		static_assert(std::is_trivially_copyable_v<T> && sizeof(T) % 2 == 0);
+#ifdef USE_SSE2
+		constexpr int patternSize{ std::lcm(16, static_cast<int>(sizeof(T))) };
+		constexpr int valuesPerPattern{ patternSize / static_cast<int>(sizeof(T)) };
+		constexpr int storesPerPattern{ patternSize / 16 };
+		for (int i = 0; i < valuesPerPattern && count > 0 && (reinterpret_cast<uintptr_t>(pPixels) & 15) != 0; ++i, --count) *pPixels++ = value;
+
+		if ((reinterpret_cast<uintptr_t>(pPixels) & 15) == 0)
+		{
+			alignas(16) T pattern[valuesPerPattern];
+			std::fill_n(pattern, valuesPerPattern, value);
+			__m128i stores[storesPerPattern];
+			for (int i = 0; i < storesPerPattern; ++i) stores[i] = _mm_load_si128(reinterpret_cast<const __m128i*>(pattern) + i);
+
+			for (; count >= valuesPerPattern; count -= valuesPerPattern, pPixels += valuesPerPattern)
+			{
+				__m128i* pStores{ reinterpret_cast<__m128i*>(pPixels) };
+				for (int i = 0; i < storesPerPattern; ++i)
+				{
+					if constexpr (isStreaming) _mm_stream_si128(pStores + i, stores[i]);
+					else _mm_store_si128(pStores + i, stores[i]);
+				}
+			}
+		}
+#endif
+		std::fill_n(pPixels, count, value);
+	}
+}
+
+namespace dae {
+
+	Renderer::Renderer(SDL_Window* pWindow, JobSystem* pJobSystem) :
+		m_pWindow(pWindow),
+		m_pJobSystem(pJobSystem)
+	{
+		//Initialize
+		SDL_GetWindowSize(pWindow, &m_WindowWidth, &m_WindowHeight);
+
+		//Create Buffers
+		m_pFrontBuffer = SDL_GetWindowSurface(pWindow);
+
+		// Rendering in the window's own pixel format lets the frames go straight into the window surface
+		m_CanPresentDirectly = m_pFrontBuffer->format->BytesPerPixel == sizeof(uint32_t);
+		InitializeSoftware(m_CanPresentDirectly ? m_pFrontBuffer->format->format : SDL_PIXELFORMAT_RGB888);
+
+		//Initialize DirectX pipeline
+		if (SUCCEEDED(InitializeDirectX()))
+		{
+			m_IsInitialized = true;
+			// std::cout << "DirectX is initialized and ready!\n";
+		}
+		else
+		{
+			std::cout << "DirectX initialization failed!\n";
+		}
+	}
+
+	Renderer::Renderer(int width, int height, JobSystem* pJobSystem) :
+		m_pJobSystem(pJobSystem)
+	{
+		// Headless: the "window" is the owned back buffer, frames stay in it (or in the upscale buffer) until SaveFrame
+		m_WindowWidth = width;
+		m_WindowHeight = height;
+		InitializeSoftware(SDL_PIXELFORMAT_RGB888);
+
+		// Only the device for the scene resources, m_IsInitialized stays false so the hardware rasterizer never runs
+		if (FAILED(InitializeDirectX()))
+		{
+			std::cout << "DirectX initialization failed!\n";
+		}
+	}
+
+	void Renderer::InitializeSoftware(uint32_t pixelFormat)
+	{
+		m_Width = m_WindowWidth;
+		m_Height = m_WindowHeight;
+
+		m_pBackBuffer = SDL_CreateRGBSurfaceWithFormat(0, m_Width, m_Height, 32, pixelFormat);
+		m_pBackBufferPixels = (uint32_t*)m_pBackBuffer->pixels;
+		m_PixelPacking = { m_pBackBuffer->format->Rshift, m_pBackBuffer->format->Gshift, m_pBackBuffer->format->Bshift, m_pBackBuffer->format->Amask };
+		if (!m_CanPresentDirectly) m_pUpscaleBuffer = SDL_CreateRGBSurfaceWithFormat(0, m_WindowWidth, m_WindowHeight, 32, pixelFormat);
+
+		m_ColorBuffer.Allocate(m_Width, m_Height);
+		m_DepthBuffer.Allocate(m_Width, m_Height);
+		m_DepthBuffer16.Allocate(m_Width, m_Height);
+		m_GBuffer.Allocate(m_Width, m_Height);
+		m_VisibilityBuffer.Allocate(m_Width, m_Height);
+		m_OITBuffer.Allocate(m_Width, m_Height);
+		m_SampleDepthBuffer.Allocate(m_Width, m_Height, m_NumSamples);
+		m_SampleColorBuffer.Allocate(m_Width, m_Height, m_NumSamples);
+		m_TileBins.resize(static_cast<size_t>((m_Width + m_TileSize - 1) / m_TileSize) * ((m_Height + m_TileSize - 1) / m_TileSize));
+		m_TileShadingRates.resize(m_TileBins.size(), ShadingRate::Rate1x1);
+		m_TileClearStates.resize(m_TileBins.size(), TileClearState::Dirty);
+		m_TileDepthRanges.resize(m_TileBins.size());
+
+		// Default rate image until one gets set: full rate in the middle of the screen, coarser towards the edges
+		const int numTilesX{ (m_WindowWidth + m_TileSize - 1) / m_TileSize };
+		m_ShadingRateImage.resize(m_TileBins.size());
+		for (int tile = 0; tile < static_cast<int>(m_ShadingRateImage.size()); ++tile)
+		{
+			const float centerX{ ((tile % numTilesX) + 0.5f) * m_TileSize };
+			const float centerY{ ((tile / numTilesX) + 0.5f) * m_TileSize };
+			const float distance{ std::max(std::abs(centerX / m_WindowWidth - 0.5f), std::abs(centerY / m_WindowHeight - 0.5f)) * 2.f };
+
+			if (distance < 0.5f) m_ShadingRateImage[tile] = ShadingRate::Rate1x1;
+			else if (distance < 0.8f) m_ShadingRateImage[tile] = ShadingRate::Rate2x2;
+			else m_ShadingRateImage[tile] = ShadingRate::Rate4x4;
+		}
+	}
+
+	Renderer::~Renderer()
+	{
+		WaitForFrame();
+
+		// Headless renderers never create the swap chain and its views
+		if (m_pRenderTargetView) m_pRenderTargetView->Release();
+		if (m_pRenderTargetBuffer) m_pRenderTargetBuffer->Release();
+		if (m_pDepthStencilView) m_pDepthStencilView->Release();
+		if (m_pDepthStencilBuffer) m_pDepthStencilBuffer->Release();
+		if (m_pSwapChain) m_pSwapChain->Release();
+
+		if (m_pDeviceContext)
+		{
+			m_pDeviceContext->ClearState();
+			m_pDeviceContext->Flush();
+			m_pDeviceContext->Release();
+		}
+		if (m_pDevice) m_pDevice->Release();
+
+		SDL_FreeSurface(m_pBackBuffer);
+		SDL_FreeSurface(m_pUpscaleBuffer);
+	}
+
+	void Renderer::Render(Scene* pScene)
+	{
+		// Nothing below may touch the buffers or meshes of a frame that is still rendering
+		WaitForFrame();
+
+		auto pMeshes{ pScene->GetMeshes() };
+		switch (pScene->GetRenderInfo().renderType)
+		{
+			case RenderType::Hardware:
+				m_HasPipelinedFrame = false;
+				RenderHardware(pMeshes, pScene->GetRenderInfo());
+				break;
+
+			case RenderType::Software:
+			{
+				// The previous pipelined frame still sits in the tile buffers, it has to leave them before
+				// the next frame or a new render scale reuses them
+				const bool hasPipelinedFrame{ m_HasPipelinedFrame };
+				if (hasPipelinedFrame) FinishFrame(m_FrameState.renderInfo);
+				m_HasPipelinedFrame = false;
+
+				if (m_PendingRenderScale != m_RenderScale) SetRenderScale(m_PendingRenderScale);
+
+				m_FrameState.camera.emplace(pScene->GetCamera());
+				m_FrameState.renderInfo = pScene->GetRenderInfo();
+
+				m_FrameState.pMeshes.clear();
+				for (const auto& mesh : pMeshes)
+				{
+					if (mesh->IsEnabled()) m_FrameState.pMeshes.emplace_back(mesh.get());
+				}
+
+				if (m_FrameState.renderInfo.useFramePipelining)
+				{
+					// The scene moves on while the frame renders, the geometry is shared and only the per frame state gets copied
+					auto& snapshots{ m_FrameState.meshSnapshots };
+					if (snapshots.size() < m_FrameState.pMeshes.size()) snapshots.resize(m_FrameState.pMeshes.size());
+					for (size_t meshId = 0; meshId < m_FrameState.pMeshes.size(); ++meshId)
+					{
+						snapshots[meshId].CopyFrameState(*m_FrameState.pMeshes[meshId]);
+						m_FrameState.pMeshes[meshId] = &snapshots[meshId];
+					}
+
+					m_pJobSystem->Submit([this]() { RenderSoftware(m_FrameState); }, &m_FrameInFlight);
+					m_HasPipelinedFrame = true;
+
+					// One frame of latency: the previous frame goes to the window while this one renders
+					if (hasPipelinedFrame) PresentSoftware(m_pFinishedFrame);
+				}
+				else
+				{
+					RenderSoftware(m_FrameState);
+					FinishFrame(m_FrameState.renderInfo);
+					PresentSoftware(m_pFinishedFrame);
+				}
+				break;
+			}
+
+			default:
+				std::cout << "ERROR getting 'RenderType' in render loop!\n";
+				break;
+		}
+	}
+
+#pragma region Software
+	void Renderer::WaitForFrame()
+	{
+		m_pJobSystem->Wait(m_FrameInFlight);
+	}
+
+	void Renderer::UpdateTriangleIdSplit(FrameState& frame)
+	{
+		const uint32_t numMeshes{ static_cast<uint32_t>(frame.pMeshes.size()) };
+
+		// At least one mesh id bit, so the triangle index never shifts by the full 32 bits
+		const uint32_t meshIdBits{ numMeshes > 1 ? static_cast<uint32_t>(std::bit_width(numMeshes - 1)) : 1u };
+		m_TriangleIdBits = 32 - meshIdBits;
+		m_TriangleIdMask = (1u << m_TriangleIdBits) - 1;
+
+		// A mesh has fewer triangles than indices, clipping can turn every one of them into a few more
+		size_t maxTriangles{};
+		for (const Mesh* pMesh : frame.pMeshes)
+		{
+			maxTriangles = std::max(maxTriangles, pMesh->GetIndices().size() * m_MaxClippedTriangles);
+		}
+
+		const bool isIdSpaceExceeded{ maxTriangles > m_TriangleIdMask };
+		if (isIdSpaceExceeded && !m_IsIdSpaceExceeded)
+		{
+			std::cout << "WARNING " << numMeshes << " meshes with up to " << maxTriangles << " triangles don't fit the visibility buffer ids, "
+				<< "the visibility buffer falls back to forward shading!\n";
+		}
+		m_IsIdSpaceExceeded = isIdSpaceExceeded;
+
+		if (isIdSpaceExceeded && frame.renderInfo.pipeline == RenderPipeline::VisibilityBuffer) frame.renderInfo.pipeline = RenderPipeline::Forward;
+	}
+
+	void Renderer::RenderSoftware(FrameState& frame)
+	{
+		UpdateTriangleIdSplit(frame);
+
+		const Camera& camera{ *frame.camera };
+		const RenderInfo& renderInfo{ frame.renderInfo };
+
+		//@START
+		UpdateShadingRates(camera, renderInfo);
+
+		// Color, depth and samples get cleared per tile by the tile jobs, see ClearTile
+		m_ClearColor = renderInfo.clearColor;
+		std::fill(m_TileClearStates.begin(), m_TileClearStates.end(), TileClearState::Dirty);
+
+		// Every tile starts over, so the format can change from one frame to the next
+		m_DepthFormat = renderInfo.depthFormat;
+		m_IsReverseZ = renderInfo.useReverseZ;
+
+		// The visualizations always go through the plain forward path
+		const bool isVisualizing{ renderInfo.visualizeBoundingBox || renderInfo.visualizeDepthBuffer };
+
+		// Deferred rasterizes the opaque meshes into the G-buffer (or visibility buffer) and shades them in one pass,
+		// transparent meshes blend over the result afterwards
+		const bool isDeferred{ renderInfo.pipeline != RenderPipeline::Forward && !isVisualizing };
+
+		// MSAA only applies to the opaque meshes of the forward pipeline, they get resolved before the transparent ones blend in
+		const bool useMSAA{ renderInfo.useMSAA && renderInfo.pipeline == RenderPipeline::Forward && !isVisualizing };
+		m_ClearSamples = useMSAA;
+
+		// The prepass lays down the final opaque depth, after which the main pass only shades pixels with an equal depth
+		const bool useDepthPrepass{ renderInfo.useDepthPrepass && !isVisualizing && !useMSAA };
+
+		// Binned transparency composites after all opaque meshes, independent of the triangle order
+		const bool useTiledTransparency{ renderInfo.transparencyMode != TransparencyMode::Ordered && !isVisualizing };
+		const bool deferTransparency{ isDeferred || useTiledTransparency || useMSAA };
+
+		// The rasterizers only depend on the effect and the render settings, so the passes are known before any mesh is projected
+		TilePass prepass{}, mainPass{}, transparentPass{};
+		const uint32_t numMeshes{ static_cast<uint32_t>(frame.pMeshes.size()) };
+		for (uint32_t meshId = 0; meshId < numMeshes; ++meshId)
+		{
+			const Mesh& mesh{ *frame.pMeshes[meshId] };
+			const EffectType effectType{ mesh.GetEffect()->GetEffectType() };
+
+			if (useDepthPrepass && effectType == EffectType::Diffuse) prepass.emplace_back(meshId, SelectRasterizeTriangle(mesh, renderInfo, true));
+
+			if (!deferTransparency || effectType != EffectType::Transparent) mainPass.emplace_back(meshId, SelectRasterizeTriangle(mesh, renderInfo, false));
+			else if (!useTiledTransparency) transparentPass.emplace_back(meshId, SelectRasterizeTriangle(mesh, renderInfo, false));
+		}
+
+		m_pFrameMeshes.assign(numMeshes, nullptr);
+		m_ClippedMeshes.clear();
+		m_ClippedMeshes.resize(numMeshes);
+		m_MeshTileBins.resize(numMeshes);
+
+		if (renderInfo.useMultiThreading)
+		{
+			// Task graph: every mesh gets projected, clipped and binned by its own job, the prepass tiles start once all
+			// meshes are binned and the main pass tiles once the prepass is done
+			JobCounter meshesDone{}, prepassDone{}, mainPassDone{};
+			for (uint32_t meshId = 0; meshId < numMeshes; ++meshId)
+			{
+				m_pJobSystem->Submit([&, meshId]() { PrepareMesh(*frame.pMeshes[meshId], meshId, camera, renderInfo); }, &meshesDone);
+			}
+
+			const int numTiles{ static_cast<int>(m_TileBins.size()) };
+			JobCounter* pMainPassDependency{ &meshesDone };
+			if (!prepass.empty())
+			{
+				for (int tile = 0; tile < numTiles; ++tile)
+				{
+					m_pJobSystem->Submit([&, tile]() { RasterizeTile(tile, prepass, renderInfo); }, &prepassDone, &meshesDone);
+				}
+				pMainPassDependency = &prepassDone;
+			}
+
+			for (int tile = 0; tile < numTiles; ++tile)
+			{
+				m_pJobSystem->Submit([&, tile]() { RasterizeTile(tile, mainPass, renderInfo); }, &mainPassDone, pMainPassDependency);
+			}
+			m_pJobSystem->Wait(mainPassDone);
+		}
+		else
+		{
+			for (uint32_t meshId = 0; meshId < numMeshes; ++meshId)
+			{
+				PrepareMesh(*frame.pMeshes[meshId], meshId, camera, renderInfo);
+			}
+			RasterizeTiles(prepass, renderInfo);
+			RasterizeTiles(mainPass, renderInfo);
+		}
+
+		if (isDeferred)
+		{
+			ResolveDeferred(renderInfo.pipeline == RenderPipeline::Deferred ? PixelOutput::GBuffer : PixelOutput::VisibilityBuffer, renderInfo);
+		}
+		else if (useMSAA)
+		{
+			ResolveMultisampled(renderInfo);
+		}
+
+		if (deferTransparency)
+		{
+			if (useTiledTransparency)
+			{
+				m_BinnedTriangles.clear();
+				for (auto& bin : m_TileBins) bin.clear();
+
+				for (uint32_t meshId = 0; meshId < numMeshes; ++meshId)
+				{
+					Mesh& mesh{ *m_pFrameMeshes[meshId] };
+					if (mesh.GetEffect()->GetEffectType() != EffectType::Transparent) continue;
+					BinTransparentMesh(mesh, meshId, renderInfo);
+				}
+
+				CompositeTransparentTiles(renderInfo);
+			}
+			else
+			{
+				// Tiles keep the scene and triangle order, so ordered blending stays correct with every tile in flight
+				RasterizeTiles(transparentPass, renderInfo);
+			}
+		}
+
+		//@END
+	}
+
+	void Renderer::FinishFrame(const RenderInfo& renderInfo)
+	{
+		// The last pass over the frame writes straight into the window surface when it can,
+		// the back buffer only holds the frame at render resolution as the source of the upscale
+		const bool isFullResolution{ m_Width == m_WindowWidth && m_Height == m_WindowHeight };
+		if (m_CanPresentDirectly) m_pFinishedFrame = m_pFrontBuffer;
+		else m_pFinishedFrame = isFullResolution ? m_pBackBuffer : m_pUpscaleBuffer;
+
+		SDL_LockSurface(m_pFinishedFrame);
+		if (isFullResolution)
+		{
+			SwizzleColorBuffer(static_cast<uint32_t*>(m_pFinishedFrame->pixels), m_pFinishedFrame->pitch / static_cast<int>(sizeof(uint32_t)), renderInfo);
+		}
+		else
+		{
+			SDL_LockSurface(m_pBackBuffer);
+			SwizzleColorBuffer(m_pBackBufferPixels, m_Width, renderInfo);
+			UpscaleToWindow(m_pFinishedFrame, renderInfo);
+			SDL_UnlockSurface(m_pBackBuffer);
+		}
+		SDL_UnlockSurface(m_pFinishedFrame);
+	}
+
+	void Renderer::PresentSoftware(SDL_Surface* pFrame)
+	{
+		// Headless frames stay where FinishFrame put them
+		if (!m_pWindow) return;
+
+		//Update SDL Surface, only a window surface that isn't 32 bit still needs the converting copy
+		if (pFrame != m_pFrontBuffer) SDL_BlitSurface(pFrame, 0, m_pFrontBuffer, 0);
+		SDL_UpdateWindowSurface(m_pWindow);
+	}
+
+	bool Renderer::SaveFrame(const std::string& path)
+	{
+		// A pipelined frame only reaches its surface in the next Render call, finishing it twice is harmless
+		WaitForFrame();
+		if (m_HasPipelinedFrame) FinishFrame(m_FrameState.renderInfo);
+
+		if (!m_pFinishedFrame)
+		{
+			std::cout << "ERROR no software frame to save to '" << path << "'!\n";
+			return false;
+		}
+		if (SDL_SaveBMP(m_pFinishedFrame, path.c_str()) != 0)
+		{
+			std::cout << "ERROR saving frame to '" << path << "': " << SDL_GetError() << '\n';
+			return false;
+		}
+		return true;
+	}
+
+	void Renderer::ProjectMesh(Mesh& mesh, const Camera& camera, const RenderInfo& renderInfo) const
+	{
+		auto worldMatrix{ mesh.GetWorldMatrix() };
+		const auto& verticesIn{ mesh.GetVerticesIn() };
+		auto& verticesOut{ mesh.GetVerticesOut() };
+
+		Matrix wvp{ worldMatrix * camera.viewMatrix * camera.projectionMatrix };
+		Matrix rotMatrix{ worldMatrix.GetAxisX(), worldMatrix.GetAxisY(), worldMatrix.GetAxisZ(), {0.f,0.f,0.f} };
+
+		// Every vertex writes its own slot, so they can be transformed in any order
+		verticesOut.resize(verticesIn.size());
+		const auto projectVertex = [&](int i)
+		{
+			Vertex_Out vert_out{ {}, {}, verticesIn[i].uv, verticesIn[i].normal, verticesIn[i].tangent, {} };
+			vert_out.normal = rotMatrix.TransformVector(verticesIn[i].normal);
+			vert_out.tangent = rotMatrix.TransformVector(verticesIn[i].tangent);
+
+			// vert_out.viewDirection = worldMatrix.TransformPoint(vert_out.position) - camera.invViewMatrix[3];
+
+			// WORLD to NDC
+			vert_out.position = wvp.TransformPoint({ verticesIn[i].position, 1.f });
+			vert_out.viewDirection = Vector3{ vert_out.position.x, vert_out.position.y, vert_out.position.z };
+			vert_out.viewDirection.Normalize();
+
+			// Perspective divide
+			const float invDepth = 1.f / vert_out.position.w;
+			vert_out.position.x *= invDepth;
+			vert_out.position.y *= invDepth;
+			vert_out.position.z *= invDepth;
+
+			verticesOut[i] = vert_out;
+		};
+
+		if (renderInfo.useMultiThreading)
+		{
+			m_pJobSystem->ParallelFor(0, static_cast<int>(verticesIn.size()), projectVertex, 256);
+		}
+		else
+		{
+			for (int i = 0; i < static_cast<int>(verticesIn.size()); i++)
+			{
+				projectVertex(i);
+			}
+		}
+	}
+
+	void Renderer::PrepareMesh(Mesh& mesh, uint32_t meshId, const Camera& camera, const RenderInfo& renderInfo)
+	{
+		ProjectMesh(mesh, camera, renderInfo);
+		if (renderInfo.useClipping)
+		{
+			m_ClippedMeshes[meshId] = std::make_unique<Mesh>(ClipMesh(mesh));
+			m_pFrameMeshes[meshId] = m_ClippedMeshes[meshId].get();
+		}
+		else
+		{
+			m_pFrameMeshes[meshId] = &mesh;
+		}
+		BinMesh(meshId, renderInfo);
+	}
+
+	void Renderer::BinMesh(uint32_t meshId, const RenderInfo& renderInfo)
+	{
+		const Mesh& mesh{ *m_pFrameMeshes[meshId] };
+		const auto& indices{ mesh.GetIndices() };
+		const auto& verticesOut{ m_pFrameMeshes[meshId]->GetVerticesOut() };
+
+		// Every mesh fills its own tile lists, so binning needs no locks and the order within a tile never changes
+		auto& bins{ m_MeshTileBins[meshId] };
+		bins.resize(m_TileBins.size());
+		for (auto& bin : bins) bin.clear();
+
+		// Return if mesh is empty (outside viewport)
+		if (indices.size() < 3) return;
+
+		const bool isTriangleList{ mesh.GetPrimitiveTopology() == PrimitiveTopology::TriangleList };
+		const uint32_t numTriangles{ static_cast<uint32_t>(isTriangleList ? indices.size() / 3 : indices.size() - 2) };
+		const int numTilesX{ (m_Width + m_TileSize - 1) / m_TileSize };
+
+		for (uint32_t triangle = 0; triangle < numTriangles; ++triangle)
+		{
+			uint32_t i0, i1, i2;
+			if (!GetTriangleIndices(mesh, triangle, i0, i1, i2)) continue;
+			if (IsOutsideFrustum(verticesOut[i0], verticesOut[i1], verticesOut[i2], renderInfo.useFastCulling)) continue;
+
+			const Vector2 v0{ ToScreenSpace(verticesOut[i0].position) };
+			const Vector2 v1{ ToScreenSpace(verticesOut[i1].position) };
+			const Vector2 v2{ ToScreenSpace(verticesOut[i2].position) };
+
+			// A pixel of margin keeps the bounds conservative for the MSAA sample offsets
+			const int minX{ std::clamp(static_cast<int>(std::floor(std::min({ v0.x, v1.x, v2.x }))) - 1, 0, m_Width - 1) };
+			const int minY{ std::clamp(static_cast<int>(std::floor(std::min({ v0.y, v1.y, v2.y }))) - 1, 0, m_Height - 1) };
+			const int maxX{ std::clamp(static_cast<int>(std::ceil(std::max({ v0.x, v1.x, v2.x }))) + 1, 0, m_Width - 1) };
+			const int maxY{ std::clamp(static_cast<int>(std::ceil(std::max({ v0.y, v1.y, v2.y }))) + 1, 0, m_Height - 1) };
+
+			for (int tileY = minY / m_TileSize; tileY <= maxY / m_TileSize; ++tileY)
+			{
+				for (int tileX = minX / m_TileSize; tileX <= maxX / m_TileSize; ++tileX)
+				{
+					bins[tileX + tileY * numTilesX].push_back(triangle);
+				}
+			}
+		}
+	}
+
+	void Renderer::RasterizeTile(int tile, const TilePass& pass, const RenderInfo& renderInfo)
+	{
+		const bool hasTriangles{ std::any_of(pass.begin(), pass.end(), [&](const auto& meshPass) { return !m_MeshTileBins[meshPass.first][tile].empty(); }) };
+		ClearTile(tile, hasTriangles);
+
+		const int numTilesX{ (m_Width + m_TileSize - 1) / m_TileSize };
+		const int minX{ (tile % numTilesX) * m_TileSize };
+		const int minY{ (tile / numTilesX) * m_TileSize };
+		const int maxX{ std::min(minX + m_TileSize, m_Width) };
+		const int maxY{ std::min(minY + m_TileSize, m_Height) };
+
+		bool hasWrittenDepth{ false };
+		for (const auto& [meshId, pRasterizeTriangle] : pass)
+		{
+			const Mesh& mesh{ *m_pFrameMeshes[meshId] };
+			const auto& verticesOut{ m_pFrameMeshes[meshId]->GetVerticesOut() };
+
+			const auto& bin{ m_MeshTileBins[meshId][tile] };
+			for (const uint32_t triangle : bin)
+			{
+				uint32_t i0, i1, i2;
+				GetTriangleIndices(mesh, triangle, i0, i1, i2);
+				assert(triangle <= m_TriangleIdMask || renderInfo.pipeline != RenderPipeline::VisibilityBuffer);
+				(this->*pRasterizeTriangle)(mesh, verticesOut, i0, i1, i2, (meshId << m_TriangleIdBits) | (triangle & m_TriangleIdMask), renderInfo, minX, minY, maxX, maxY);
+			}
+
+			// Only opaque meshes write depth, with MSAA they write the sample depths until the resolve
+			hasWrittenDepth |= !bin.empty() && mesh.GetEffect()->GetEffectType() == EffectType::Diffuse && !m_ClearSamples;
+		}
+
+		// One scan once the pass is done with the tile, the range only gets tighter while the pass runs so it stays conservative meanwhile
+		if (hasWrittenDepth) UpdateTileDepthRange(tile);
+	}
+
+	void Renderer::RasterizeTiles(const TilePass& pass, const RenderInfo& renderInfo)
+	{
+		// Empty passes still visit every tile, the first pass of the frame is what clears them
+		const int numTiles{ static_cast<int>(m_TileBins.size()) };
+		const auto rasterizeTile = [&](int tile) { RasterizeTile(tile, pass, renderInfo); };
+
+		if (renderInfo.useMultiThreading)
+		{
+			m_pJobSystem->ParallelFor(0, numTiles, rasterizeTile);
+		}
+		else
+		{
+			for (int tile = 0; tile < numTiles; ++tile)
+			{
+				rasterizeTile(tile);
+			}
+		}
+	}
+
+	void Renderer::ClearTile(int tile, bool needsDepth)
+	{
+		TileClearState& state{ m_TileClearStates[tile] };
+		if (state == TileClearState::Cleared || (state == TileClearState::ColorCleared && !needsDepth)) return;
+
+		// Tiles are contiguous blocks, the padding of the edge tiles gets cleared along with them
+		constexpr int tileElements{ static_cast<int>(TiledBuffer<ColorRGB>::GetElementsPerTile()) };
+		if (state == TileClearState::Dirty)
+		{
+			// A tile that gets rasterized right after keeps its color in cache, an empty one is only read by the swizzle
+			if (needsDepth) FillPixels<false>(m_ColorBuffer.GetTile(tile), tileElements, m_ClearColor);
+			else FillPixels<true>(m_ColorBuffer.GetTile(tile), tileElements, m_ClearColor);
+			state = TileClearState::ColorCleared;
+		}
+
+		if (needsDepth)
+		{
+			const uint32_t farDepth{ GetFarDepthKey() };
+			if (m_DepthFormat == DepthFormat::D16) FillPixels<false>(m_DepthBuffer16.GetTile(tile), tileElements, static_cast<uint16_t>(farDepth));
+			else FillPixels<false>(m_DepthBuffer.GetTile(tile), tileElements, farDepth);
+			m_TileDepthRanges[tile] = { farDepth, farDepth };
+			if (m_ClearSamples)
+			{
+				FillPixels<false>(m_SampleDepthBuffer.GetTile(tile), tileElements * static_cast<int>(m_NumSamples), farDepth);
+				FillPixels<false>(m_SampleColorBuffer.GetTile(tile), tileElements * static_cast<int>(m_NumSamples), m_ClearColor);
+			}
+			state = TileClearState::Cleared;
+		}
+#ifdef USE_SSE2
+		else
+		{
+			// Streaming stores are weakly ordered, make them visible before the job counts as done
+			_mm_sfence();
+		}
+#endif
+	}
+
+	void Renderer::UpdateTileDepthRange(int tile)
+	{
+		const int numTilesX{ (m_Width + m_TileSize - 1) / m_TileSize };
+		const int width{ std::min(m_TileSize, m_Width - (tile % numTilesX) * m_TileSize) };
+		const int height{ std::min(m_TileSize, m_Height - (tile / numTilesX) * m_TileSize) };
+
+		// The padding of edge tiles stays at the clear depth, it is left out so it can't hold the farthest depth back
+		const auto findRange = [&](const auto* pTileDepths)
+		{
+			TileDepthRange range{ UINT32_MAX, 0 };
+			for (int localY = 0; localY < height; ++localY)
+			{
+				const auto [pMin, pMax] = std::minmax_element(pTileDepths + localY * m_TileSize, pTileDepths + localY * m_TileSize + width);
+				range.min = std::min<uint32_t>(range.min, *pMin);
+				range.max = std::max<uint32_t>(range.max, *pMax);
+			}
+			return range;
+		};
+
+		if (m_DepthFormat == DepthFormat::D16) m_TileDepthRanges[tile] = findRange(m_DepthBuffer16.GetTile(tile));
+		else m_TileDepthRanges[tile] = findRange(m_DepthBuffer.GetTile(tile));
+	}
+
+	bool Renderer::GetTriangleIndices(const Mesh& mesh, uint32_t triangle, uint32_t& i0, uint32_t& i1, uint32_t& i2) const
+	{
+		const auto& indices{ mesh.GetIndices() };
+		const bool isTriangleList{ mesh.GetPrimitiveTopology() == PrimitiveTopology::TriangleList };
+
+		const uint32_t i{ isTriangleList ? triangle * 3 : triangle };
+		i0 = indices[i];
+		i1 = indices[i + 1];
+		i2 = indices[i + 2];
+
+		if (i0 == i1 || i1 == i2) return false;
+
+		// swap index1 and index2 for odd triangles (ccw to cw)
+		if ((i & 1) == 1 && !isTriangleList)
+		{
+			std::swap(i1, i2);
+		}
+		return true;
+	}
+
+	bool Renderer::IsOutsideFrustum(const Vertex_Out& v0, const Vertex_Out& v1, const Vertex_Out& v2, bool useFastCulling) const
+	{
+		return
+			v0.position.x < -1 || v0.position.x > 1 ||
+			v0.position.y < -1 || v0.position.y > 1 ||
+			v0.position.z < 0 || v0.position.z > 1 ||
+			v1.position.x < -1 || v1.position.x > 1 ||
+			v1.position.y < -1 || v1.position.y > 1 ||
+			v1.position.z < 0 || v1.position.z > 1 ||
+			v2.position.x < -1 || v2.position.x > 1 ||
+			v2.position.y < -1 || v2.position.y > 1 ||
+			v2.position.z < 0 || v2.position.z > 1
+			&& useFastCulling;
+	}
+
+	Vector2 Renderer::ToScreenSpace(const Vector4& position) const
+	{
+		return { (position.x + 1) * 0.5f * m_Width, (1 - position.y) * 0.5f * m_Height };
+	}
+
+	Vertex_Out Renderer::ReconstructVertex(Mesh& mesh, uint32_t triangle, const Vector2& pixelPos) const
+	{
+		const auto& verticesOut{ mesh.GetVerticesOut() };
+
+		uint32_t i0, i1, i2;
+		GetTriangleIndices(mesh, triangle, i0, i1, i2);
+
+		// Same setup the rasterizer did, but only for this one pixel
+		const Vector2 v0{ ToScreenSpace(verticesOut[i0].position) };
+		const Vector2 v1{ ToScreenSpace(verticesOut[i1].position) };
+		const Vector2 v2{ ToScreenSpace(verticesOut[i2].position) };
+
+		const Vector2 v0v1 = v1 - v0;
+		const Vector2 v1v2 = v2 - v1;
+		const Vector2 v2v0 = v0 - v2;
+		const float invTriArea = 1.f / Vector2::Cross(v0v1, v2 - v0);
+
+		const float w0{ Vector2::Cross(v1v2, pixelPos - v1) * invTriArea };
+		const float w1{ Vector2::Cross(v2v0, pixelPos - v2) * invTriArea };
+		const float w2{ Vector2::Cross(v0v1, pixelPos - v0) * invTriArea };
+
+		Vertex_Out pixelVertex = Vertex_Out::Interpolate(verticesOut[i0], verticesOut[i1], verticesOut[i2], w0, w1, w2);
+
+		// Coarse derivatives over the quad the pixel sits in, so the mip level matches the G-buffer path
+		const float invW0{ 1.f / verticesOut[i0].position.w };
+		const float invW1{ 1.f / verticesOut[i1].position.w };
+		const float invW2{ 1.f / verticesOut[i2].position.w };
+		const Vector2 uvW0{ verticesOut[i0].uv * invW0 };
+		const Vector2 uvW1{ verticesOut[i1].uv * invW1 };
+		const Vector2 uvW2{ verticesOut[i2].uv * invW2 };
+		const auto getUv = [&](const Vector2& position)
+		{
+			const float quadW0{ Vector2::Cross(v1v2, position - v1) * invTriArea };
+			const float quadW1{ Vector2::Cross(v2v0, position - v2) * invTriArea };
+			const float quadW2{ Vector2::Cross(v0v1, position - v0) * invTriArea };
+			return (uvW0 * quadW0 + uvW1 * quadW1 + uvW2 * quadW2) / (invW0 * quadW0 + invW1 * quadW1 + invW2 * quadW2);
+		};
+
+		const Vector2 quadPos{ static_cast<float>(static_cast<uint32_t>(pixelPos.x) & ~1u), static_cast<float>(static_cast<uint32_t>(pixelPos.y) & ~1u) };
+		const Vector2 quadUv{ getUv(quadPos) };
+		const Vector2 ddx{ getUv({ quadPos.x + 1.f, quadPos.y }) - quadUv };
+		const Vector2 ddy{ getUv({ quadPos.x, quadPos.y + 1.f }) - quadUv };
+		pixelVertex.uvLod = 0.5f * std::log2f(std::max(Vector2::Dot(ddx, ddx), Vector2::Dot(ddy, ddy)));
+
+		return pixelVertex;
+	}
+
+	template<size_t index>
+	constexpr Renderer::RasterizeTriangleFunc Renderer::GetRasterizeTriangle()
+	{
+		constexpr bool isReverseZ{ (index % 2) == 1 };
+		constexpr DepthFormat depthFormat{ static_cast<DepthFormat>((index / 2) % static_cast<size_t>(DepthFormat::SIZE)) };
+		constexpr size_t depthStride{ 2 * static_cast<size_t>(DepthFormat::SIZE) };
+		constexpr bool useDepthEqual{ ((index / depthStride) % 2) == 1 };
+		constexpr bool useFastShading{ ((index / (depthStride * 2)) % 2) == 1 };
+		constexpr bool useNormalMap{ ((index / (depthStride * 4)) % 2) == 1 };
+		constexpr ShadingMode shadingMode{ static_cast<ShadingMode>((index / (depthStride * 8)) % static_cast<size_t>(ShadingMode::SIZE)) };
+		constexpr size_t shadingStride{ depthStride * 8 * static_cast<size_t>(ShadingMode::SIZE) };
+		constexpr EffectType effectType{ static_cast<EffectType>((index / shadingStride) % static_cast<size_t>(EffectType::SIZE)) };
+		constexpr size_t effectStride{ shadingStride * static_cast<size_t>(EffectType::SIZE) };
+		constexpr CullMode cullMode{ static_cast<CullMode>((index / effectStride) % static_cast<size_t>(CullMode::SIZE)) };
+		constexpr PixelOutput output{ static_cast<PixelOutput>(index / (effectStride * static_cast<size_t>(CullMode::SIZE))) };
+
+		// Options a variant doesn't read collapse onto one instantiation
+		if constexpr (output == PixelOutput::BoundingBox)
+			return &Renderer::RasterizeTriangle<PixelOutput::BoundingBox, CullMode::None, EffectType::Diffuse, ShadingMode::FinalColor, false, false, false, DepthFormat::D32, false>;
+		else if constexpr (output == PixelOutput::Depth)
+			return &Renderer::RasterizeTriangle<PixelOutput::Depth, cullMode, effectType, ShadingMode::FinalColor, false, false, false, depthFormat, isReverseZ>;
+		else if constexpr (output == PixelOutput::DepthPrepass)
+			return &Renderer::RasterizeTriangle<PixelOutput::DepthPrepass, cullMode, EffectType::Diffuse, ShadingMode::FinalColor, false, false, false, depthFormat, isReverseZ>;
+		else if constexpr (output == PixelOutput::ShadeMultisampled)
+			return &Renderer::RasterizeTriangle<PixelOutput::ShadeMultisampled, cullMode, EffectType::Diffuse, shadingMode, useNormalMap, useFastShading, false, depthFormat, isReverseZ>;
+		else if constexpr (output == PixelOutput::GBuffer || output == PixelOutput::VisibilityBuffer)
+			return &Renderer::RasterizeTriangle<output, cullMode, EffectType::Diffuse, ShadingMode::FinalColor, false, false, useDepthEqual, depthFormat, isReverseZ>;
+		else if constexpr (effectType == EffectType::Transparent)
+			return &Renderer::RasterizeTriangle<PixelOutput::Shade, cullMode, EffectType::Transparent, ShadingMode::FinalColor, false, false, false, depthFormat, isReverseZ>;
+		else
+			return &Renderer::RasterizeTriangle<PixelOutput::Shade, cullMode, EffectType::Diffuse, shadingMode, useNormalMap, useFastShading, useDepthEqual, depthFormat, isReverseZ>;
+	}
+
+	template<size_t... indices>
+	constexpr std::array<Renderer::RasterizeTriangleFunc, sizeof...(indices)> Renderer::MakeRasterizeTriangleTable(std::index_sequence<indices...>)
+	{
+		return { GetRasterizeTriangle<indices>()... };
+	}
+
+	Renderer::RasterizeTriangleFunc Renderer::SelectRasterizeTriangle(const Mesh& mesh, const RenderInfo& renderInfo, bool isDepthPrepass) const
+	{
+		constexpr size_t numVariants
+		{
+			static_cast<size_t>(PixelOutput::SIZE) * static_cast<size_t>(CullMode::SIZE) * static_cast<size_t>(EffectType::SIZE) *
+			static_cast<size_t>(ShadingMode::SIZE) * 2 * 2 * 2 * static_cast<size_t>(DepthFormat::SIZE) * 2
+		};
+		static constexpr std::array<RasterizeTriangleFunc, numVariants> rasterizeTriangleTable{ MakeRasterizeTriangleTable(std::make_index_sequence<numVariants>{}) };
+
+		PixelOutput output{ PixelOutput::Shade };
+		if (isDepthPrepass) output = PixelOutput::DepthPrepass;
+		else if (renderInfo.visualizeBoundingBox) output = PixelOutput::BoundingBox;
+		else if (renderInfo.visualizeDepthBuffer) output = PixelOutput::Depth;
+		else if (mesh.GetEffect()->GetEffectType() == EffectType::Diffuse)
+		{
+			if (renderInfo.pipeline == RenderPipeline::Deferred) output = PixelOutput::GBuffer;
+			else if (renderInfo.pipeline == RenderPipeline::VisibilityBuffer) output = PixelOutput::VisibilityBuffer;
+			else if (renderInfo.useMSAA) output = PixelOutput::ShadeMultisampled;
+		}
+
+		// Same layout as GetRasterizeTriangle decodes
+		size_t index{ static_cast<size_t>(output) };
+		index = index * static_cast<size_t>(CullMode::SIZE) + static_cast<size_t>(mesh.GetCullMode());
+		index = index * static_cast<size_t>(EffectType::SIZE) + static_cast<size_t>(mesh.GetEffect()->GetEffectType());
+		index = index * static_cast<size_t>(ShadingMode::SIZE) + static_cast<size_t>(renderInfo.shadingMode);
+		index = index * 2 + static_cast<size_t>(renderInfo.useNormalMap);
+		index = index * 2 + static_cast<size_t>(renderInfo.useFastShading);
+		index = index * 2 + static_cast<size_t>(renderInfo.useDepthPrepass);
+		index = index * static_cast<size_t>(DepthFormat::SIZE) + static_cast<size_t>(renderInfo.depthFormat);
+		index = index * 2 + static_cast<size_t>(renderInfo.useReverseZ);
+
+		return rasterizeTriangleTable[index];
+	}
+
+	template<Renderer::PixelOutput output, CullMode cullMode, EffectType effectType, ShadingMode shadingMode, bool useNormalMap, bool useFastShading, bool useDepthEqual, DepthFormat depthFormat, bool isReverseZ>
+	void Renderer::RasterizeTriangle(const Mesh& mesh, const std::vector<Vertex_Out>& verticesOut, uint32_t i0, uint32_t i1, uint32_t i2, uint32_t primitiveId, const RenderInfo& renderInfo,
+		int tileMinX, int tileMinY, int tileMaxX, int tileMaxY) const
+	{
+		// CULLING
+		if (IsOutsideFrustum(verticesOut[i0], verticesOut[i1], verticesOut[i2], renderInfo.useFastCulling)) return;
+
+		// PROJECTION to SS / RASTER
+		const Vector2 v0{ ToScreenSpace(verticesOut[i0].position) };
+		const Vector2 v1{ ToScreenSpace(verticesOut[i1].position) };
+		const Vector2 v2{ ToScreenSpace(verticesOut[i2].position) };
+
+		const Vector2 v0v1 = v1 - v0;
+		const Vector2 v0v2 = v2 - v0;
+		const Vector2 v1v2 = v2 - v1;
+		const Vector2 v2v0 = v0 - v2;
+
+		const float invTriArea = 1.f / Vector2::Cross(v0v1, v0v2);
+
+		// Perspective correct depth interpolates 1/z
+		const float invZ0{ 1.f / verticesOut[i0].position.z };
+		const float invZ1{ 1.f / verticesOut[i1].position.z };
+		const float invZ2{ 1.f / verticesOut[i2].position.z };
+
+		// Samples sit up to 3/8 of a pixel away from the pixel position
+		constexpr float sampleExtent{ output == PixelOutput::ShadeMultisampled ? 0.375f : 0.f };
+
+		Bounds aabb;
+		aabb.min.x = static_cast<float>(std::clamp(static_cast<int>(std::ceilf(std::min(v0.x, std::min(v1.x, v2.x)) - sampleExtent)), 0, m_Width - 1));
+		aabb.min.y = static_cast<float>(std::clamp(static_cast<int>(std::ceilf(std::min(v0.y, std::min(v1.y, v2.y)) - sampleExtent)), 0, m_Height - 1));
+		aabb.max.x = static_cast<float>(std::clamp(static_cast<int>(std::ceilf(std::max(v0.x, std::max(v1.x, v2.x)) + sampleExtent)), 0, m_Width - 1));
+		aabb.max.y = static_cast<float>(std::clamp(static_cast<int>(std::ceilf(std::max(v0.y, std::max(v1.y, v2.y)) + sampleExtent)), 0, m_Height - 1));
+
+		// Scissor to the tile being rasterized, tiles start on multiples of 4 so quads and shading rate blocks never straddle two
+		aabb.min.x = std::max(aabb.min.x, static_cast<float>(tileMinX));
+		aabb.min.y = std::max(aabb.min.y, static_cast<float>(tileMinY));
+		aabb.max.x = std::min(aabb.max.x, static_cast<float>(tileMaxX));
+		aabb.max.y = std::min(aabb.max.y, static_cast<float>(tileMaxY));
+		if (aabb.min.x >= aabb.max.x || aabb.min.y >= aabb.max.y) return;
+
+		// The bounding box was just scissored to this tile, so every pixel it still covers lies in the tile's block
+		// of the frame buffers and GetIndexInTile can address it directly. The triangle itself may span many tiles
+		const uint32_t tileIndex{ static_cast<uint32_t>(tileMinX / m_TileSize + (tileMinY / m_TileSize) * ((m_Width + m_TileSize - 1) / m_TileSize)) };
+		const auto getPixelIndex = [&](uint32_t px, uint32_t py) { return TiledBuffer<uint32_t>::GetIndexInTile(tileIndex, px - tileMinX, py - tileMinY); };
+
+		// Hierarchical depth, the interpolated depth never gets nearer than the nearest vertex.
+		// Multisampling tests against the sample depths, which the tile range doesn't cover
+		if constexpr (output != PixelOutput::BoundingBox && output != PixelOutput::ShadeMultisampled)
+		{
+			const uint32_t nearestDepth{ std::min({ EncodeDepth<depthFormat, isReverseZ>(verticesOut[i0].position.z), EncodeDepth<depthFormat, isReverseZ>(verticesOut[i1].position.z), EncodeDepth<depthFormat, isReverseZ>(verticesOut[i2].position.z) }) };
+			const uint32_t tileFarthestDepth{ m_TileDepthRanges[tileIndex].max };
+			if (useDepthEqual ? nearestDepth > tileFarthestDepth : nearestDepth >= tileFarthestDepth) return;
+		}
+
+		// Setup shared by every quad of the triangle, the uv derivatives only need uv/w and 1/w
+		constexpr bool needsAttributes{ output == PixelOutput::Shade || output == PixelOutput::ShadeMultisampled || output == PixelOutput::GBuffer };
+		const Vertex_Out& vertex0{ verticesOut[i0] };
+		const Vertex_Out& vertex1{ verticesOut[i1] };
+		const Vertex_Out& vertex2{ verticesOut[i2] };
+
+		const float invW0{ 1.f / vertex0.position.w };
+		const float invW1{ 1.f / vertex1.position.w };
+		const float invW2{ 1.f / vertex2.position.w };
+		const Vector2 uvW0{ vertex0.uv * invW0 };
+		const Vector2 uvW1{ vertex1.uv * invW1 };
+		const Vector2 uvW2{ vertex2.uv * invW2 };
+
+		// Quads start on even coordinates so neighbouring triangles agree on them
+		const uint32_t minQuadX{ static_cast<uint32_t>(aabb.min.x) & ~1u };
+		const uint32_t minQuadY{ static_cast<uint32_t>(aabb.min.y) & ~1u };
+
+		// Variable rate shading only broadcasts opaque colors, transparent pixels blend with what is underneath them.
+		// A 4x4 block spans two rows of quads, so its color is kept per block column until the next block row starts
+		constexpr bool supportsShadingRate{ (output == PixelOutput::Shade || output == PixelOutput::ShadeMultisampled) && effectType == EffectType::Diffuse };
+		const bool useShadingRate{ supportsShadingRate && renderInfo.shadingRatePolicy != ShadingRatePolicy::Off };
+		const uint32_t numTilesX{ static_cast<uint32_t>((m_Width + m_TileSize - 1) / m_TileSize) };
+		thread_local std::vector<std::pair<uint32_t, ColorRGB>> blockColors;
+		if (useShadingRate) blockColors.assign((static_cast<uint32_t>(aabb.max.x) - (minQuadX & ~3u)) / 4 + 1, { 0, ColorRGB{} });
+
+		// SHADING LOGIC
+		// Pixels are handled in 2x2 quads, lane = (x & 1) | ((y & 1) << 1). Lanes that are not covered
+		// (outside the triangle, outside the bounding box or failing the depth test) still get their
+		// barycentrics so they can act as helpers for the uv derivatives, but are never written
+		for (uint32_t qy{ minQuadY }; qy < aabb.max.y; qy += 2)
+		{
+			for (uint32_t qx{ minQuadX }; qx < aabb.max.x; qx += 2)
+			{
+				float w0[4], w1[4], w2[4];
+				float zBufferValues[4]{};
+				uint32_t sampleCoverage[4]{};
+				uint32_t quadCoverage{};
+
+				for (uint32_t lane = 0; lane < 4; ++lane)
+				{
+					const uint32_t px{ qx + (lane & 1) };
+					const uint32_t py{ qy + (lane >> 1) };
+					const Vector2 pixelPos{ static_cast<float>(px), static_cast<float>(py) };
+
+					const float edge0{ Vector2::Cross(v1v2, pixelPos - v1) };
+					const float edge1{ Vector2::Cross(v2v0, pixelPos - v2) };
+					const float edge2{ Vector2::Cross(v0v1, pixelPos - v0) };
+
+					w0[lane] = edge0 * invTriArea;
+					w1[lane] = edge1 * invTriArea;
+					w2[lane] = edge2 * invTriArea;
+
+					if (px < aabb.min.x || px >= aabb.max.x || py < aabb.min.y || py >= aabb.max.y) continue;
+
+					const uint32_t pixelIndex{ getPixelIndex(px, py) };
+
+					if constexpr (output == PixelOutput::BoundingBox)
+					{
+						m_ColorBuffer[pixelIndex] = colors::White;
+						continue;
+					}
+
+					if constexpr (output == PixelOutput::ShadeMultisampled)
+					{
+						// Coverage and depth per sample, the pixel still only gets shaded once
+						uint32_t* pSampleDepths{ m_SampleDepthBuffer.GetData() + pixelIndex * m_NumSamples };
+						for (uint32_t sample = 0; sample < m_NumSamples; ++sample)
+						{
+							const Vector2 samplePos{ pixelPos.x + m_SampleOffsets[sample][0], pixelPos.y + m_SampleOffsets[sample][1] };
+							const float s0{ Vector2::Cross(v1v2, samplePos - v1) };
+							const float s1{ Vector2::Cross(v2v0, samplePos - v2) };
+							const float s2{ Vector2::Cross(v0v1, samplePos - v0) };
+							if (!IsInside<cullMode>(s0, s1, s2)) continue;
+
+							const uint32_t sampleDepth{ EncodeDepth<depthFormat, isReverseZ>(1.f / ((invZ0 * s0 + invZ1 * s1 + invZ2 * s2) * invTriArea)) };
+							if (sampleDepth >= pSampleDepths[sample]) continue;
+
+							pSampleDepths[sample] = sampleDepth;
+							sampleCoverage[lane] |= 1u << sample;
+						}
+						if (sampleCoverage[lane] == 0) continue;
+					}
+					else
+					{
+						if (!IsInside<cullMode>(edge0, edge1, edge2)) continue;
+
+						// Depth test, at the precision of the depth format
+						const float zBufferValue{ 1.f / (invZ0 * w0[lane] + invZ1 * w1[lane] + invZ2 * w2[lane]) };
+						const uint32_t depthKey{ EncodeDepth<depthFormat, isReverseZ>(zBufferValue) };
+						if constexpr (useDepthEqual)
+						{
+							// The prepass already wrote this exact value for the visible surface
+							if (depthKey != LoadDepth<depthFormat>(pixelIndex)) continue;
+						}
+						else
+						{
+							if (depthKey >= LoadDepth<depthFormat>(pixelIndex)) continue;
+							if constexpr (effectType == EffectType::Diffuse) StoreDepth<depthFormat>(pixelIndex, depthKey);
+						}
+						zBufferValues[lane] = zBufferValue;
+					}
 
-#define USE_CONCURENCY
+					quadCoverage |= 1u << lane;
+				}
+
+				if (quadCoverage == 0) continue;
+				if constexpr (output == PixelOutput::DepthPrepass) continue;
+
+				// Coarse derivatives, one mip level for the whole quad
+				float quadUvLod{};
+				if constexpr (needsAttributes)
+				{
+					Vector2 quadUv[4];
+					for (uint32_t lane = 0; lane < 4; ++lane)
+					{
+						const float invW{ invW0 * w0[lane] + invW1 * w1[lane] + invW2 * w2[lane] };
+						quadUv[lane] = (uvW0 * w0[lane] + uvW1 * w1[lane] + uvW2 * w2[lane]) / invW;
+					}
+
+					const Vector2 ddx{ quadUv[1] - quadUv[0] };
+					const Vector2 ddy{ quadUv[2] - quadUv[0] };
+					quadUvLod = 0.5f * std::log2f(std::max(Vector2::Dot(ddx, ddx), Vector2::Dot(ddy, ddy)));
+				}
+
+				// Lanes with the same (lane & groupMask) share one shaded color
+				uint32_t groupMask{ 3 };
+				bool isBlockRate{ false };
+				if (useShadingRate)
+				{
+					switch (m_TileShadingRates[(qx / m_TileSize) + (qy / m_TileSize) * numTilesX])
+					{
+					case ShadingRate::Rate1x2:
+						groupMask = 1;
+						break;
+					case ShadingRate::Rate2x2:
+						groupMask = 0;
+						break;
+					case ShadingRate::Rate4x4:
+						groupMask = 0;
+						isBlockRate = true;
+						break;
+					default:
+						break;
+					}
+				}
+				const uint32_t blockColumn{ (qx - (minQuadX & ~3u)) / 4 };
+				const uint32_t blockRow{ qy / 4 + 1 }; // 0 marks an empty entry
+				ColorRGB groupColors[4];
+				uint32_t shadedGroups{};
+
+				for (uint32_t lane = 0; lane < 4; ++lane)
+				{
+					if ((quadCoverage & (1u << lane)) == 0) continue;
+
+					const uint32_t pixelIndex{ getPixelIndex(qx + (lane & 1), qy + (lane >> 1)) };
+
+					if constexpr (output == PixelOutput::VisibilityBuffer)
+					{
+						m_VisibilityBuffer[pixelIndex] = primitiveId;
+						continue;
+					}
+					else if constexpr (output == PixelOutput::GBuffer)
+					{
+						const Vertex_Out pixelVertex = Vertex_Out::Interpolate(vertex0, vertex1, vertex2, w0[lane], w1[lane], w2[lane]);
+
+						GBufferTexel& texel{ m_GBuffer[pixelIndex] };
+						texel.normal = pixelVertex.normal;
+						texel.tangent = pixelVertex.tangent;
+						texel.viewDirection = pixelVertex.viewDirection;
+						texel.uv = pixelVertex.uv;
+						texel.uvLod = quadUvLod;
+						texel.meshId = primitiveId >> m_TriangleIdBits;
+						continue;
+					}
+
+					ColorRGB finalColor{};
+					if constexpr (output == PixelOutput::Depth)
+					{
+						const float remappedDepth{ Remap(isReverseZ ? 1.f - zBufferValues[lane] : zBufferValues[lane], 0.995f, 1.f) };
+						finalColor = { remappedDepth, remappedDepth, remappedDepth };
+					}
+					else
+					{
+						// Depth and coverage stay per pixel, only the shading gets reused
+						const uint32_t group{ lane & groupMask };
+						if (shadedGroups & (1u << group))
+						{
+							finalColor = groupColors[group];
+						}
+						else if (isBlockRate && blockColors[blockColumn].first == blockRow)
+						{
+							finalColor = blockColors[blockColumn].second;
+						}
+						else
+						{
+							Vertex_Out pixelVertex = Vertex_Out::Interpolate(vertex0, vertex1, vertex2, w0[lane], w1[lane], w2[lane]);
+							pixelVertex.uvLod = quadUvLod;
+
+							ColorRGB currPixelColor{};
+							if constexpr (effectType == EffectType::Transparent) currPixelColor = m_ColorBuffer[pixelIndex];
+							finalColor = ShadePixel<effectType, shadingMode, useNormalMap, useFastShading>(mesh, pixelVertex, currPixelColor);
+
+							if (isBlockRate) blockColors[blockColumn] = { blockRow, finalColor };
+						}
+						groupColors[group] = finalColor;
+						shadedGroups |= 1u << group;
+					}
+
+					//Update Color in Buffer
+					if constexpr (output == PixelOutput::ShadeMultisampled)
+					{
+						// The resolve averages displayable colors, so the samples get tonemapped before it
+						finalColor.MaxToOne();
 
-namespace dae {
+						ColorRGB* pSampleColors{ m_SampleColorBuffer.GetData() + pixelIndex * m_NumSamples };
+						for (uint32_t sample = 0; sample < m_NumSamples; ++sample)
+						{
+							if (sampleCoverage[lane] & (1u << sample)) pSampleColors[sample] = finalColor;
+						}
+					}
+					else
+					{
+						m_ColorBuffer[pixelIndex] = finalColor;
+					}
+				}
+			}
+		}
+	}
 
-	Renderer::Renderer(SDL_Window* pWindow) :
-		m_pWindow(pWindow)
+	template<CullMode cullMode>
+	bool Renderer::IsInside(float w0, float w1, float w2)
 	{
-		//Initialize
-		SDL_GetWindowSize(pWindow, &m_Width, &m_Height);
-
-		//Create Buffers
-		m_pFrontBuffer = SDL_GetWindowSurface(pWindow);
-		m_pBackBuffer = SDL_CreateRGBSurface(0, m_Width, m_Height, 32, 0, 0, 0, 0);
-		m_pBackBufferPixels = (uint32_t*)m_pBackBuffer->pixels;
+		const bool isFrontFace{ w0 >= 0.f && w1 >= 0.f && w2 >= 0.f };
+		const bool isBackFace{ w0 < 0.f && w1 < 0.f && w2 < 0.f };
+		if constexpr (cullMode == CullMode::FrontFace) return isBackFace;
+		else if constexpr (cullMode == CullMode::BackFace) return isFrontFace;
+		else return isFrontFace || isBackFace;
+	}
 
-		m_pDepthBufferPixels = new float[m_Width * m_Height];
+	void Renderer::ResolveMultisampled(const RenderInfo& renderInfo)
+	{
+		const int numTilesX{ (m_Width + m_TileSize - 1) / m_TileSize };
+		const int numTiles{ static_cast<int>(m_TileClearStates.size()) };
+		const auto resolveTile = [&](int tile)
+		{
+			// The samples of a tile without triangles never got cleared, its pixels keep the clear color
+			if (m_TileClearStates[tile] != TileClearState::Cleared) return;
+
+			const int minX{ (tile % numTilesX) * m_TileSize };
+			const int minY{ (tile / numTilesX) * m_TileSize };
+			const int maxX{ std::min(minX + m_TileSize, m_Width) };
+			const int maxY{ std::min(minY + m_TileSize, m_Height) };
+#ifdef USE_SSE2
+			// SSE2 only compares signed, flipping the sign bit maps the unsigned key order onto it
+			const __m128i signBit{ _mm_set1_epi32(INT32_MIN) };
+			const auto minKeys = [](__m128i x, __m128i y)
+			{
+				const __m128i isLess{ _mm_cmplt_epi32(x, y) };
+				return _mm_or_si128(_mm_and_si128(isLess, x), _mm_andnot_si128(isLess, y));
+			};
+#endif
+			for (int py{ minY }; py < maxY; ++py)
+			{
+				for (int px{ minX }; px < maxX; ++px)
+				{
+					const uint32_t pixelIndex{ GetPixelIndex(px, py) };
+					const ColorRGB* pSampleColors{ m_SampleColorBuffer.GetData() + pixelIndex * m_NumSamples };
+					const uint32_t* pSampleDepths{ m_SampleDepthBuffer.GetData() + pixelIndex * m_NumSamples };
+
+#ifdef USE_SSE2
+					// r0 g0 b0 r1 | g1 b1 r2 g2 | b2 r3 g3 b3, every sample shuffled to the front of its own vector and added up
+					const float* pFloats{ reinterpret_cast<const float*>(pSampleColors) };
+					const __m128 a{ _mm_loadu_ps(pFloats) };
+					const __m128 b{ _mm_loadu_ps(pFloats + 4) };
+					const __m128 c{ _mm_loadu_ps(pFloats + 8) };
+					const __m128 r1g1b1{ _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 0, 3, 3)) }; // r1 r1 g1 b1
+					const __m128 sample1{ _mm_shuffle_ps(r1g1b1, r1g1b1, _MM_SHUFFLE(3, 3, 2, 0)) };
+					const __m128 sample2{ _mm_shuffle_ps(b, c, _MM_SHUFFLE(0, 0, 3, 2)) };
+					const __m128 sample3{ _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 2, 1)) };
+					const __m128 sum{ _mm_add_ps(_mm_add_ps(a, sample1), _mm_add_ps(sample2, sample3)) };
+
+					alignas(16) float resolved[4];
+					_mm_store_ps(resolved, _mm_mul_ps(sum, _mm_set1_ps(1.f / m_NumSamples)));
+					m_ColorBuffer[pixelIndex] = { resolved[0], resolved[1], resolved[2] };
+
+					// The sample depths are keys already, the nearest one is the smallest
+					__m128i keys{ _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pSampleDepths)), signBit) };
+					keys = minKeys(keys, _mm_shuffle_epi32(keys, _MM_SHUFFLE(1, 0, 3, 2)));
+					keys = minKeys(keys, _mm_shuffle_epi32(keys, _MM_SHUFFLE(2, 3, 0, 1)));
+					StoreDepth(pixelIndex, static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_xor_si128(keys, signBit))));
+#else
+					m_ColorBuffer[pixelIndex] = (pSampleColors[0] + pSampleColors[1] + pSampleColors[2] + pSampleColors[3]) * (1.f / m_NumSamples);
+
+					// The sample depths are keys already, the nearest one is the smallest
+					StoreDepth(pixelIndex, std::min({ pSampleDepths[0], pSampleDepths[1], pSampleDepths[2], pSampleDepths[3] }));
+#endif
+				}
+			}
+			UpdateTileDepthRange(tile);
+		};
 
-		//Initialize DirectX pipeline
-		if (SUCCEEDED(InitializeDirectX()))
+		if (renderInfo.useMultiThreading)
 		{
-			m_IsInitialized = true;
-			// std::cout << "DirectX is initialized and ready!\n";
+			m_pJobSystem->ParallelFor(0, numTiles, resolveTile);
 		}
 		else
 		{
-			std::cout << "DirectX initialization failed!\n";
+			for (int tile = 0; tile < numTiles; ++tile)
+			{
+				resolveTile(tile);
+			}
 		}
 	}
 
-	Renderer::~Renderer()
+	void Renderer::SwizzleColorBuffer(uint32_t* pPixels, int stride, const RenderInfo& renderInfo) const
 	{
-		m_pRenderTargetView->Release();
-		m_pRenderTargetBuffer->Release();
-		m_pDepthStencilView->Release();
-		m_pDepthStencilBuffer->Release();
-		m_pSwapChain->Release();
+		const int numTilesX{ (m_Width + m_TileSize - 1) / m_TileSize };
+		const int numTiles{ static_cast<int>(m_TileClearStates.size()) };
+		const auto swizzleTile = [&](int tile)
+		{
+			const int minX{ (tile % numTilesX) * m_TileSize };
+			const int minY{ (tile / numTilesX) * m_TileSize };
+			const int width{ std::min(minX + m_TileSize, m_Width) - minX };
+			const int height{ std::min(minY + m_TileSize, m_Height) - minY };
 
-		if (m_pDeviceContext)
+			const ColorRGB* pTileColors{ m_ColorBuffer.GetTile(tile) };
+			for (int localY = 0; localY < height; ++localY)
+			{
+				const ColorRGB* pColors{ pTileColors + localY * m_TileSize };
+				uint32_t* pRow{ pPixels + minX + (minY + localY) * stride };
+				int localX{ 0 };
+#ifdef USE_SSE2
+				// 4 colors are 3 aligned vectors, rows of a tile start on 16 bytes (64 colors of 12 bytes)
+				const __m128 one{ _mm_set1_ps(1.f) };
+				const __m128 zero{ _mm_setzero_ps() };
+				const __m128 channelMax{ _mm_set1_ps(255.f) };
+				const __m128i redShift{ _mm_cvtsi32_si128(m_PixelPacking.redShift) };
+				const __m128i greenShift{ _mm_cvtsi32_si128(m_PixelPacking.greenShift) };
+				const __m128i blueShift{ _mm_cvtsi32_si128(m_PixelPacking.blueShift) };
+				const __m128i alphaMask{ _mm_set1_epi32(static_cast<int>(m_PixelPacking.alphaMask)) };
+				for (; localX + 4 <= width; localX += 4)
+				{
+					// r0 g0 b0 r1 | g1 b1 r2 g2 | b2 r3 g3 b3 to one vector per channel
+					const float* pFloats{ reinterpret_cast<const float*>(pColors + localX) };
+					const __m128 a{ _mm_load_ps(pFloats) };
+					const __m128 b{ _mm_load_ps(pFloats + 4) };
+					const __m128 c{ _mm_load_ps(pFloats + 8) };
+					__m128 red{ _mm_shuffle_ps(a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 0, 3, 2)), _MM_SHUFFLE(3, 0, 3, 0)) };
+					__m128 green{ _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0)) };
+					__m128 blue{ _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0)) };
+
+					// MaxToOne: scale by 1 / max(r, g, b) once the brightest channel passes 1
+					const __m128 scale{ _mm_div_ps(channelMax, _mm_max_ps(_mm_max_ps(red, _mm_max_ps(green, blue)), one)) };
+					red = _mm_min_ps(_mm_max_ps(_mm_mul_ps(red, scale), zero), channelMax);
+					green = _mm_min_ps(_mm_max_ps(_mm_mul_ps(green, scale), zero), channelMax);
+					blue = _mm_min_ps(_mm_max_ps(_mm_mul_ps(blue, scale), zero), channelMax);
+
+					__m128i packed{ _mm_or_si128(_mm_sll_epi32(_mm_cvttps_epi32(red), redShift), _mm_sll_epi32(_mm_cvttps_epi32(green), greenShift)) };
+					packed = _mm_or_si128(_mm_or_si128(packed, _mm_sll_epi32(_mm_cvttps_epi32(blue), blueShift)), alphaMask);
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(pRow + localX), packed);
+				}
+#endif
+				for (; localX < width; ++localX)
+				{
+					pRow[localX] = PackColor(pColors[localX]);
+				}
+			}
+		};
+
+		if (renderInfo.useMultiThreading)
 		{
-			m_pDeviceContext->ClearState();
-			m_pDeviceContext->Flush();
-			m_pDeviceContext->Release();
+			m_pJobSystem->ParallelFor(0, numTiles, swizzleTile);
+		}
+		else
+		{
+			for (int tile = 0; tile < numTiles; ++tile)
+			{
+				swizzleTile(tile);
+			}
 		}
-		m_pDevice->Release();
-
-		delete[] m_pDepthBufferPixels;
 	}
 
-	void Renderer::Render(Scene* pScene)
+	void Renderer::SetShadingRateImage(const std::vector<ShadingRate>& tileRates)
 	{
-		auto pMeshes{ pScene->GetMeshes() };
-		switch (pScene->GetRenderInfo().renderType)
+		if (tileRates.size() != m_ShadingRateImage.size())
 		{
-			case RenderType::Hardware:
-				RenderHardware(pMeshes, pScene->GetRenderInfo());
-				break;
-
-			case RenderType::Software:
-				RenderSoftware(pMeshes, pScene->GetCamera(), pScene->GetRenderInfo());
-				break;
-
-			default:
-				std::cout << "ERROR getting 'RenderType' in render loop!\n";
-				break;
+			std::cout << "ERROR shading rate image needs one rate per tile (" << m_ShadingRateImage.size() << "), got " << tileRates.size() << "!\n";
+			return;
 		}
+		m_ShadingRateImage = tileRates;
 	}
 
-#pragma region Software
-	void Renderer::RenderSoftware(std::vector<std::shared_ptr<Mesh>>& pMeshes, const Camera& camera, const RenderInfo& renderInfo)
+	void Renderer::UpdateShadingRates(const Camera& camera, const RenderInfo& renderInfo)
 	{
-		//@START
-		//Lock BackBuffer
-		SDL_FillRect(m_pBackBuffer, NULL, SDL_MapRGB(m_pBackBuffer->format, (Uint8) (renderInfo.clearColor.r * 255), (Uint8) (renderInfo.clearColor.g * 255), (Uint8) (renderInfo.clearColor.b * 255)));
-		SDL_LockSurface(m_pBackBuffer);
-
-		// Initialize depth buffer with max value
-		std::fill_n(m_pDepthBufferPixels, m_Width * m_Height, 1.f);
+		switch (renderInfo.shadingRatePolicy)
+		{
+		case ShadingRatePolicy::Off:
+			std::fill(m_TileShadingRates.begin(), m_TileShadingRates.end(), ShadingRate::Rate1x1);
+			return;
+		case ShadingRatePolicy::RateImage:
+		{
+			// The image covers the window, at a lower render resolution a tile takes the rate under its center
+			const int numTilesX{ (m_Width + m_TileSize - 1) / m_TileSize };
+			const int numImageTilesX{ (m_WindowWidth + m_TileSize - 1) / m_TileSize };
+			const int numImageTilesY{ (m_WindowHeight + m_TileSize - 1) / m_TileSize };
+			for (int tile = 0; tile < static_cast<int>(m_TileShadingRates.size()); ++tile)
+			{
+				const float centerX{ ((tile % numTilesX) + 0.5f) * m_TileSize * m_WindowWidth / m_Width };
+				const float centerY{ ((tile / numTilesX) + 0.5f) * m_TileSize * m_WindowHeight / m_Height };
+				const int imageX{ std::min(static_cast<int>(centerX) / m_TileSize, numImageTilesX - 1) };
+				const int imageY{ std::min(static_cast<int>(centerY) / m_TileSize, numImageTilesY - 1) };
+				m_TileShadingRates[tile] = m_ShadingRateImage[imageX + imageY * numImageTilesX];
+			}
+			return;
+		}
+		default:
+			break;
+		}
 
-		for (auto mesh : pMeshes)
+		const int numTilesX{ (m_Width + m_TileSize - 1) / m_TileSize };
+		const auto updateTile = [&](int tile)
 		{
-			if (!mesh->IsEnabled()) continue;
+			const int minX{ (tile % numTilesX) * m_TileSize };
+			const int minY{ (tile / numTilesX) * m_TileSize };
+			const int maxX{ std::min(minX + m_TileSize, m_Width) };
+			const int maxY{ std::min(minY + m_TileSize, m_Height) };
 
-			ProjectMesh(mesh, camera);
-			if (renderInfo.useClipping)
+			if (renderInfo.shadingRatePolicy == ShadingRatePolicy::LuminanceGradient)
 			{
-				Mesh clippedMesh{ ClipMesh(*mesh) };
-				RasterizeMesh(clippedMesh, renderInfo);
+				// The color buffer still holds the previous frame, none of its tiles got cleared yet
+				const auto luminance = [&](int px, int py)
+				{
+					ColorRGB color{ m_ColorBuffer[GetPixelIndex(px, py)] };
+					color.MaxToOne();
+					return 0.2126f * color.r + 0.7152f * color.g + 0.0722f * color.b;
+				};
+
+				// Mean horizontal and vertical luminance step, sampled on every other pixel
+				float gradientX{}, gradientY{};
+				int numSamples{};
+				for (int py{ minY }; py < maxY - 1; py += 2)
+				{
+					for (int px{ minX }; px < maxX - 1; px += 2)
+					{
+						const float center{ luminance(px, py) };
+						gradientX += std::abs(luminance(px + 1, py) - center);
+						gradientY += std::abs(luminance(px, py + 1) - center);
+						++numSamples;
+					}
+				}
+				if (numSamples > 0)
+				{
+					gradientX /= numSamples;
+					gradientY /= numSamples;
+				}
+
+				ShadingRate rate{ ShadingRate::Rate1x1 };
+				if (gradientX < m_FlatGradient && gradientY < m_FlatGradient) rate = ShadingRate::Rate4x4;
+				else if (gradientX < m_SmoothGradient && gradientY < m_SmoothGradient) rate = ShadingRate::Rate2x2;
+				else if (gradientY < m_SmoothGradient) rate = ShadingRate::Rate1x2;
+				m_TileShadingRates[tile] = rate;
 			}
 			else
-				RasterizeMesh(*mesh, renderInfo);
-		}
+			{
+				// The previous frame left the depth of tiles without triangles stale, those were empty
+				const float nearestDepth{ GetStandardDepth(m_TileClearStates[tile] == TileClearState::Cleared ? m_TileDepthRanges[tile].min : GetFarDepthKey()) };
 
-		//@END
-		//Update SDL Surface
-		SDL_UnlockSurface(m_pBackBuffer);
-		SDL_BlitSurface(m_pBackBuffer, 0, m_pFrontBuffer, 0);
-		SDL_UpdateWindowSurface(m_pWindow);
+				// Back from the [0, 1] projected depth to view space distance
+				const float distance{ (camera.nearPlane * camera.farPlane) / (camera.farPlane - nearestDepth * (camera.farPlane - camera.nearPlane)) };
+
+				ShadingRate rate{ ShadingRate::Rate1x1 };
+				if (distance >= m_FarShadingDistance) rate = ShadingRate::Rate4x4;
+				else if (distance >= m_NearShadingDistance) rate = ShadingRate::Rate2x2;
+				m_TileShadingRates[tile] = rate;
+			}
+		};
+
+		if (renderInfo.useMultiThreading)
+		{
+			m_pJobSystem->ParallelFor(0, static_cast<int>(m_TileShadingRates.size()), updateTile);
+		}
+		else
+		{
+			for (int tile = 0; tile < static_cast<int>(m_TileShadingRates.size()); ++tile)
+			{
+				updateTile(tile);
+			}
+		}
 	}
 
-	void Renderer::ProjectMesh(std::shared_ptr<Mesh> mesh, const Camera& camera) const
+	void Renderer::UpdateResolutionScale(float elapsedSec, const RenderInfo& renderInfo)
 	{
-		auto worldMatrix{ mesh->GetWorldMatrix() };
-		auto verticesIn{ mesh->GetVerticesIn() };
-		auto& verticesOut{ mesh->GetVerticesOut() };
+		if (!renderInfo.useDynamicResolution || renderInfo.renderType != RenderType::Software)
+		{
+			m_PendingRenderScale = 1.f;
+			m_SmoothedFrameTime = 0.f;
+			return;
+		}
 
-		Matrix wvp{ worldMatrix * camera.viewMatrix * camera.projectionMatrix };
-		Matrix rotMatrix{ worldMatrix.GetAxisX(), worldMatrix.GetAxisY(), worldMatrix.GetAxisZ(), {0.f,0.f,0.f} };
+		// Smoothed so a single slow frame does not make the resolution jump around
+		m_SmoothedFrameTime = m_SmoothedFrameTime > 0.f ? m_SmoothedFrameTime + (elapsedSec - m_SmoothedFrameTime) * 0.2f : elapsedSec;
+
+		// Give the smoothed time a few frames to catch up with the last change
+		if (++m_FramesSinceScaleChange < m_ScaleChangeCooldown) return;
 
-		verticesOut.clear();
-		verticesOut.reserve(verticesIn.size());
-		for (int i = 0; i < verticesIn.size(); i++)
+		float scale{ m_PendingRenderScale };
+		if (m_SmoothedFrameTime > m_FrameTimeBudget)
 		{
-			Vertex_Out vert_out{ {}, {}, verticesIn[i].uv, verticesIn[i].normal, verticesIn[i].tangent, {} };
-			vert_out.normal = rotMatrix.TransformVector(verticesIn[i].normal);
-			vert_out.tangent = rotMatrix.TransformVector(verticesIn[i].tangent);
+			// Pixel cost grows with the area, so the scale follows the square root of the time ratio
+			scale *= std::sqrt(m_FrameTimeBudget / m_SmoothedFrameTime);
+			scale = std::floor(scale / m_RenderScaleStep) * m_RenderScaleStep;
+		}
+		else if (m_SmoothedFrameTime < m_FrameTimeBudget * 0.75f)
+		{
+			// Only creep back up with plenty of headroom left, to avoid bouncing around the budget
+			scale += m_RenderScaleStep;
+		}
 
-			// vert_out.viewDirection = worldMatrix.TransformPoint(vert_out.position) - camera.invViewMatrix[3];
+		scale = std::clamp(scale, m_MinRenderScale, 1.f);
+		if (scale != m_PendingRenderScale)
+		{
+			m_PendingRenderScale = scale;
+			m_FramesSinceScaleChange = 0;
+		}
+	}
 
-			// WORLD to NDC
-			vert_out.position = wvp.TransformPoint({ verticesIn[i].position, 1.f });
-			vert_out.viewDirection = Vector3{ vert_out.position.x, vert_out.position.y, vert_out.position.z };
-			vert_out.viewDirection.Normalize();
+	void Renderer::SetRenderScale(float scale)
+	{
+		m_RenderScale = scale;
+
+		// Even sizes keep every 2x2 quad inside the buffers
+		m_Width = std::clamp(static_cast<int>(m_WindowWidth * scale) & ~1, 2, m_WindowWidth);
+		m_Height = std::clamp(static_cast<int>(m_WindowHeight * scale) & ~1, 2, m_WindowHeight);
+
+		const size_t numTiles{ static_cast<size_t>((m_Width + m_TileSize - 1) / m_TileSize) * ((m_Height + m_TileSize - 1) / m_TileSize) };
+		m_TileBins.resize(numTiles);
+		m_TileShadingRates.resize(numTiles, ShadingRate::Rate1x1);
+		// The tiles moved, nothing of the last frame's depth is usable anymore
+		m_TileClearStates.assign(numTiles, TileClearState::Dirty);
+		m_TileDepthRanges.resize(numTiles);
+		m_ColorBuffer.SetWidth(m_Width);
+		m_DepthBuffer.SetWidth(m_Width);
+		m_DepthBuffer16.SetWidth(m_Width);
+		m_GBuffer.SetWidth(m_Width);
+		m_VisibilityBuffer.SetWidth(m_Width);
+		m_OITBuffer.SetWidth(m_Width);
+		m_SampleDepthBuffer.SetWidth(m_Width);
+		m_SampleColorBuffer.SetWidth(m_Width);
+
+		// Pixel centers line up between both resolutions, the border pixels clamp
+		const auto buildTaps = [](std::vector<UpscaleTap>& taps, int windowSize, int renderSize)
+		{
+			taps.resize(windowSize);
+			const float ratio{ static_cast<float>(renderSize) / windowSize };
+			for (int i = 0; i < windowSize; ++i)
+			{
+				const float source{ std::clamp((i + 0.5f) * ratio - 0.5f, 0.f, static_cast<float>(renderSize - 1)) };
+				const int index0{ static_cast<int>(source) };
+				taps[i].index0 = index0;
+				taps[i].index1 = std::min(index0 + 1, renderSize - 1);
+				taps[i].weight = static_cast<int>((source - index0) * 128.f + 0.5f);
+			}
+		};
+		buildTaps(m_UpscaleColumns, m_WindowWidth, m_Width);
+		buildTaps(m_UpscaleRows, m_WindowHeight, m_Height);
+	}
 
-			// Perspective divide
-			const float invDepth = 1.f / vert_out.position.w;
-			vert_out.position.x *= invDepth;
-			vert_out.position.y *= invDepth;
-			vert_out.position.z *= invDepth;
+	void Renderer::UpscaleToWindow(SDL_Surface* pTarget, const RenderInfo& renderInfo) const
+	{
+		uint32_t* pUpscalePixels{ static_cast<uint32_t*>(pTarget->pixels) };
+		const int upscaleStride{ pTarget->pitch / static_cast<int>(sizeof(uint32_t)) };
+
+		const auto upscaleRow = [&](int py)
+		{
+			const UpscaleTap& row{ m_UpscaleRows[py] };
+			const uint32_t* pTop{ m_pBackBufferPixels + row.index0 * m_Width };
+			const uint32_t* pBottom{ m_pBackBufferPixels + row.index1 * m_Width };
+			uint32_t* pOut{ pUpscalePixels + py * upscaleStride };
+
+#ifdef USE_SSE2
+			const __m128i zero{ _mm_setzero_si128() };
+			const __m128i weightY{ _mm_set1_epi16(static_cast<short>(row.weight)) };
+#endif
+			for (int px{ 0 }; px < m_WindowWidth; ++px)
+			{
+				const UpscaleTap& column{ m_UpscaleColumns[px] };
+
+#ifdef USE_SSE2
+				// Top texel in the low half and bottom texel in the high half, 16 bit per channel,
+				// so one lerp does both rows and a second one blends them. 8 bit * 7 bit weights fit in 16 bit
+				const __m128i left{ _mm_unpacklo_epi8(_mm_unpacklo_epi32(_mm_cvtsi32_si128(static_cast<int>(pTop[column.index0])), _mm_cvtsi32_si128(static_cast<int>(pBottom[column.index0]))), zero) };
+				const __m128i right{ _mm_unpacklo_epi8(_mm_unpacklo_epi32(_mm_cvtsi32_si128(static_cast<int>(pTop[column.index1])), _mm_cvtsi32_si128(static_cast<int>(pBottom[column.index1]))), zero) };
+				const __m128i horizontal{ _mm_add_epi16(left, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(right, left), _mm_set1_epi16(static_cast<short>(column.weight))), 7)) };
+				const __m128i bottom{ _mm_srli_si128(horizontal, 8) };
+				const __m128i blended{ _mm_add_epi16(horizontal, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(bottom, horizontal), weightY), 7)) };
+				pOut[px] = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_packus_epi16(blended, zero)));
+#else
+				uint32_t blended{};
+				for (uint32_t shift{ 0 }; shift < 32; shift += 8)
+				{
+					const int topLeft{ static_cast<int>((pTop[column.index0] >> shift) & 0xFF) };
+					const int topRight{ static_cast<int>((pTop[column.index1] >> shift) & 0xFF) };
+					const int bottomLeft{ static_cast<int>((pBottom[column.index0] >> shift) & 0xFF) };
+					const int bottomRight{ static_cast<int>((pBottom[column.index1] >> shift) & 0xFF) };
+
+					const int top{ topLeft + (((topRight - topLeft) * column.weight) >> 7) };
+					const int bottom{ bottomLeft + (((bottomRight - bottomLeft) * column.weight) >> 7) };
+					blended |= static_cast<uint32_t>(top + (((bottom - top) * row.weight) >> 7)) << shift;
+				}
+				pOut[px] = blended;
+#endif
+			}
+		};
 
-			verticesOut.push_back(vert_out);
+		if (renderInfo.useMultiThreading)
+		{
+			m_pJobSystem->ParallelFor(0, m_WindowHeight, upscaleRow);
+		}
+		else
+		{
+			for (int py = 0; py < m_WindowHeight; ++py)
+			{
+				upscaleRow(py);
+			}
 		}
 	}
 
-	void Renderer::RasterizeMesh(Mesh& mesh, const RenderInfo& renderInfo) const
+	void Renderer::BinTransparentMesh(Mesh& mesh, uint32_t meshId, const RenderInfo& renderInfo)
 	{
-		auto indices{ mesh.GetIndices() };
-		auto verticesOut{ mesh.GetVerticesOut() };
-		auto primitiveTopology{ mesh.GetPrimitiveTopology() };
-		auto cullMode{ mesh.GetCullMode() };
+		const auto& indices{ mesh.GetIndices() };
+		const auto& verticesOut{ mesh.GetVerticesOut() };
+		if (indices.size() < 3) return;
 
-		// Return if mesh is empty (outside viewport)
-		if (indices.empty()) return;
+		const bool isTriangleList{ mesh.GetPrimitiveTopology() == PrimitiveTopology::TriangleList };
+		const uint32_t numTriangles{ static_cast<uint32_t>(isTriangleList ? indices.size() / 3 : indices.size() - 2) };
+		const int numTilesX{ (m_Width + m_TileSize - 1) / m_TileSize };
 
-		const uint32_t numTriangles{ static_cast<uint32_t>(indices.size() / 3.f) };
+		for (uint32_t triangle = 0; triangle < numTriangles; ++triangle)
+		{
+			BinnedTriangle binned{};
+			binned.meshId = meshId;
+			if (!GetTriangleIndices(mesh, triangle, binned.i0, binned.i1, binned.i2)) continue;
+
+			const Vertex_Out& vertex0{ verticesOut[binned.i0] };
+			const Vertex_Out& vertex1{ verticesOut[binned.i1] };
+			const Vertex_Out& vertex2{ verticesOut[binned.i2] };
+			if (IsOutsideFrustum(vertex0, vertex1, vertex2, renderInfo.useFastCulling)) continue;
+
+			binned.v0 = ToScreenSpace(vertex0.position);
+			binned.v1 = ToScreenSpace(vertex1.position);
+			binned.v2 = ToScreenSpace(vertex2.position);
+
+			// The winding decides the facing for every pixel of the triangle, so culling happens once here
+			const float triArea{ Vector2::Cross(binned.v1 - binned.v0, binned.v2 - binned.v0) };
+			if (triArea == 0.f) continue;
+			if (triArea > 0.f && mesh.GetCullMode() == CullMode::FrontFace) continue;
+			if (triArea < 0.f && mesh.GetCullMode() == CullMode::BackFace) continue;
+			binned.invTriArea = 1.f / triArea;
+
+			binned.invZ0 = 1.f / vertex0.position.z;
+			binned.invZ1 = 1.f / vertex1.position.z;
+			binned.invZ2 = 1.f / vertex2.position.z;
+			binned.nearestDepth = std::min({ EncodeDepth(vertex0.position.z), EncodeDepth(vertex1.position.z), EncodeDepth(vertex2.position.z) });
+
+			const float uvArea{ std::abs(Vector2::Cross(vertex1.uv - vertex0.uv, vertex2.uv - vertex0.uv)) };
+			binned.uvLod = 0.5f * std::log2f(uvArea * std::abs(binned.invTriArea));
+
+			binned.minX = std::clamp(static_cast<int>(std::ceilf(std::min(binned.v0.x, std::min(binned.v1.x, binned.v2.x)))), 0, m_Width - 1);
+			binned.minY = std::clamp(static_cast<int>(std::ceilf(std::min(binned.v0.y, std::min(binned.v1.y, binned.v2.y)))), 0, m_Height - 1);
+			binned.maxX = std::clamp(static_cast<int>(std::ceilf(std::max(binned.v0.x, std::max(binned.v1.x, binned.v2.x)))), 0, m_Width - 1);
+			binned.maxY = std::clamp(static_cast<int>(std::ceilf(std::max(binned.v0.y, std::max(binned.v1.y, binned.v2.y)))), 0, m_Height - 1);
+			if (binned.minX >= binned.maxX || binned.minY >= binned.maxY) continue;
+
+			const uint32_t binnedIndex{ static_cast<uint32_t>(m_BinnedTriangles.size()) };
+			m_BinnedTriangles.push_back(binned);
+
+			for (int tileY{ binned.minY / m_TileSize }; tileY <= (binned.maxY - 1) / m_TileSize; ++tileY)
+			{
+				for (int tileX{ binned.minX / m_TileSize }; tileX <= (binned.maxX - 1) / m_TileSize; ++tileX)
+				{
+					m_TileBins[tileX + tileY * numTilesX].push_back(binnedIndex);
+				}
+			}
+		}
+	}
+
+	void Renderer::CompositeTransparentTiles(const RenderInfo& renderInfo)
+	{
+		const int numTilesX{ (m_Width + m_TileSize - 1) / m_TileSize };
+		const int numTiles{ static_cast<int>(m_TileBins.size()) };
+		const auto compositeTile = [&](int tile)
+		{
+			if (m_TileBins[tile].empty()) return;
+			ClearTile(tile, true);
+
+			const int minX{ (tile % numTilesX) * m_TileSize };
+			const int minY{ (tile / numTilesX) * m_TileSize };
+			const int maxX{ std::min(minX + m_TileSize, m_Width) };
+			const int maxY{ std::min(minY + m_TileSize, m_Height) };
+			DispatchDepth([&](auto depthFormat, auto isReverseZ)
+			{
+				constexpr DepthFormat format{ decltype(depthFormat)::value };
+				constexpr bool isReversed{ decltype(isReverseZ)::value };
+				if (renderInfo.transparencyMode == TransparencyMode::SortedTiles) CompositeTransparentTile<TransparencyMode::SortedTiles, format, isReversed>(tile, minX, minY, maxX, maxY);
+				else CompositeTransparentTile<TransparencyMode::WeightedBlended, format, isReversed>(tile, minX, minY, maxX, maxY);
+			});
+		};
+
+		if (renderInfo.useMultiThreading)
+		{
+			m_pJobSystem->ParallelFor(0, numTiles, compositeTile);
+		}
+		else
+		{
+			for (int tile = 0; tile < numTiles; ++tile)
+			{
+				compositeTile(tile);
+			}
+		}
+	}
 
-		if (renderInfo.useMultiThreading && mesh.GetEffect()->GetEffectType() == EffectType::Diffuse)
+	template<TransparencyMode mode, DepthFormat depthFormat, bool isReverseZ>
+	void Renderer::CompositeTransparentTile(int tile, int minX, int minY, int maxX, int maxY)
+	{
+		// WeightedBlended: weighted blended OIT (McGuire & Bavoil 2013), accumulates weighted premultiplied color and the product of (1 - alpha).
+		// Both are sums/products so the result doesn't depend on the order the triangles arrive in.
+		// SortedTiles: sorts the tile's triangles front to back and composites with the under operator,
+		// a pixel stops shading once its remaining transmittance can't show up in 8-bit anymore.
+		std::fill_n(m_OITBuffer.GetTile(tile), TiledBuffer<OITTexel>::GetElementsPerTile(), OITTexel{ {}, 0.f, 1.f });
+
+		std::vector<uint32_t>& bin{ m_TileBins[tile] };
+		int numOpenPixels{ (maxX - minX) * (maxY - minY) };
+		if constexpr (mode == TransparencyMode::SortedTiles)
 		{
-			concurrency::parallel_for(0U, numTriangles,
-				[&](int triangle)
+			std::stable_sort(begin(bin), end(bin), [&](uint32_t a, uint32_t b)
 				{
-					const int i{ triangle * 3 };
-					const int i0 = indices[i];
-					int i1 = indices[i + 1];
-					int i2 = indices[i + 2];
+					return m_BinnedTriangles[a].nearestDepth < m_BinnedTriangles[b].nearestDepth;
+				});
+		}
+
+		constexpr float saturatedTransmittance{ 1.f / 255.f };
+		for (const uint32_t binnedIndex : bin)
+		{
+			if constexpr (mode == TransparencyMode::SortedTiles)
+			{
+				// Everything behind is hidden, skip the remaining layers entirely
+				if (numOpenPixels <= 0) break;
+			}
 
-					if (i0 == i1 || i1 == i2) return;
+			const BinnedTriangle& binned{ m_BinnedTriangles[binnedIndex] };
+			Mesh& mesh{ *m_pFrameMeshes[binned.meshId] };
+			const auto& verticesOut{ mesh.GetVerticesOut() };
+			const Vertex_Out& vertex0{ verticesOut[binned.i0] };
+			const Vertex_Out& vertex1{ verticesOut[binned.i1] };
+			const Vertex_Out& vertex2{ verticesOut[binned.i2] };
 
-					// swap index1 and index2 for odd triangles (ccw to cw)
-					if ((i & 1) == 1 && primitiveTopology == PrimitiveTopology::TriangleStrip)
+			const Vector2 v0v1{ binned.v1 - binned.v0 };
+			const Vector2 v1v2{ binned.v2 - binned.v1 };
+			const Vector2 v2v0{ binned.v0 - binned.v2 };
+
+			for (int py{ std::max(minY, binned.minY) }; py < std::min(maxY, binned.maxY); ++py)
+			{
+				for (int px{ std::max(minX, binned.minX) }; px < std::min(maxX, binned.maxX); ++px)
+				{
+					const uint32_t pixelIndex{ GetPixelIndex(px, py) };
+					OITTexel& texel{ m_OITBuffer[pixelIndex] };
+					if constexpr (mode == TransparencyMode::SortedTiles)
 					{
-						std::swap(i1, i2);
+						if (texel.revealage < saturatedTransmittance) continue;
 					}
 
-					// CULLING
-					if (
-						verticesOut[i0].position.x < -1 || verticesOut[i0].position.x > 1 ||
-						verticesOut[i0].position.y < -1 || verticesOut[i0].position.y > 1 ||
-						verticesOut[i0].position.z < 0 || verticesOut[i0].position.z > 1 ||
-						verticesOut[i1].position.x < -1 || verticesOut[i1].position.x > 1 ||
-						verticesOut[i1].position.y < -1 || verticesOut[i1].position.y > 1 ||
-						verticesOut[i1].position.z < 0 || verticesOut[i1].position.z > 1 ||
-						verticesOut[i2].position.x < -1 || verticesOut[i2].position.x > 1 ||
-						verticesOut[i2].position.y < -1 || verticesOut[i2].position.y > 1 ||
-						verticesOut[i2].position.z < 0 || verticesOut[i2].position.z > 1
-						&& renderInfo.useFastCulling) return;
-
-					// PROJECTION to SS / RASTER
-					const Vector2 v0{ (verticesOut[i0].position.x + 1) * 0.5f * m_Width, (1 - verticesOut[i0].position.y) * 0.5f * m_Height };
-					const Vector2 v1{ (verticesOut[i1].position.x + 1) * 0.5f * m_Width, (1 - verticesOut[i1].position.y) * 0.5f * m_Height };
-					const Vector2 v2{ (verticesOut[i2].position.x + 1) * 0.5f * m_Width, (1 - verticesOut[i2].position.y) * 0.5f * m_Height };
-
-					const Vector2 v0v1 = v1 - v0;
-					const Vector2 v0v2 = v2 - v0;
-					const Vector2 v1v2 = v2 - v1;
-					const Vector2 v2v0 = v0 - v2;
-
-					const float invTriArea = 1.f / Vector2::Cross(v0v1, v0v2);
-
-					Bounds aabb;
-					aabb.min.x = static_cast<float>(std::clamp(static_cast<int>(std::ceilf(std::min(v0.x, std::min(v1.x, v2.x)))), 0, m_Width - 1));
-					aabb.min.y = static_cast<float>(std::clamp(static_cast<int>(std::ceilf(std::min(v0.y, std::min(v1.y, v2.y)))), 0, m_Height - 1));
-					aabb.max.x = static_cast<float>(std::clamp(static_cast<int>(std::ceilf(std::max(v0.x, std::max(v1.x, v2.x)))), 0, m_Width - 1));
-					aabb.max.y = static_cast<float>(std::clamp(static_cast<int>(std::ceilf(std::max(v0.y, std::max(v1.y, v2.y)))), 0, m_Height - 1));
-
-					// SHADING LOGIC
-					for (uint32_t px{ static_cast<uint32_t>(aabb.min.x) }; px < aabb.max.x; ++px)
+					const Vector2 pixelPos{ static_cast<float>(px), static_cast<float>(py) };
+
+					const float w0{ Vector2::Cross(v1v2, pixelPos - binned.v1) * binned.invTriArea };
+					const float w1{ Vector2::Cross(v2v0, pixelPos - binned.v2) * binned.invTriArea };
+					const float w2{ Vector2::Cross(v0v1, pixelPos - binned.v0) * binned.invTriArea };
+					if (w0 < 0.f || w1 < 0.f || w2 < 0.f) continue;
+
+					// Depth test against the opaque surfaces only, transparent surfaces never write depth
+					const float depth{ 1.f / (binned.invZ0 * w0 + binned.invZ1 * w1 + binned.invZ2 * w2) };
+					if (EncodeDepth<depthFormat, isReverseZ>(depth) >= LoadDepth<depthFormat>(pixelIndex)) continue;
+
+					// Perspective correct uv, nothing else is needed to shade a transparent surface
+					const float invW0{ w0 / vertex0.position.w };
+					const float invW1{ w1 / vertex1.position.w };
+					const float invW2{ w2 / vertex2.position.w };
+					const float viewDepth{ 1.f / (invW0 + invW1 + invW2) };
+					const Vector2 uv{ (vertex0.uv * invW0 + vertex1.uv * invW1 + vertex2.uv * invW2) * viewDepth };
+
+					const Vector4 diffuseAlpha{ mesh.GetDiffuseMap()->SampleRGBA(uv, binned.uvLod) };
+					const float alpha{ diffuseAlpha.w };
+					if (alpha <= 0.01f) continue;
+
+					const ColorRGB color{ diffuseAlpha.x, diffuseAlpha.y, diffuseAlpha.z };
+					if constexpr (mode == TransparencyMode::SortedTiles)
 					{
-						for (uint32_t py{ static_cast<uint32_t>(aabb.min.y) }; py < aabb.max.y; ++py)
-						{
-							if (renderInfo.visualizeBoundingBox)
-							{
-								ColorRGB finalColor = { 1, 1, 1 };
-
-								//Update Color in Buffer
-								finalColor.MaxToOne();
-
-								m_pBackBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBackBuffer->format,
-									static_cast<uint8_t>(finalColor.r * 255),
-									static_cast<uint8_t>(finalColor.g * 255),
-									static_cast<uint8_t>(finalColor.b * 255));
-
-								continue;
-							}
-
-							const Vector2 pixelPos{ static_cast<float>(px), static_cast<float>(py) };
-
-							const Vector2 v1p = pixelPos - v1;
-							float w0 = Vector2::Cross(v1v2, v1p);
-
-							const Vector2 v2p = pixelPos - v2;
-							float w1 = Vector2::Cross(v2v0, v2p);
-
-							const Vector2 v0p = pixelPos - v0;
-							float w2 = Vector2::Cross(v0v1, v0p);
-
-							const bool isFrontFace{ w0 >= 0.f && w1 >= 0.f && w2 >= 0.f };
-							const bool isBackFace{ w0 < 0.f && w1 < 0.f && w2 < 0.f };
-							if (isFrontFace && cullMode == CullMode::FrontFace) continue;
-							if (isBackFace && cullMode == CullMode::BackFace) continue;
-							if (!isFrontFace && !isBackFace) continue;
-
-							w0 *= invTriArea;
-							w1 *= invTriArea;
-							w2 *= invTriArea;
-
-							// Depth test
-							const float zBufferValue
-							{
-								1.f / (
-									((1.f / verticesOut[i0].position.z) * w0) +
-									((1.f / verticesOut[i1].position.z) * w1) +
-									((1.f / verticesOut[i2].position.z) * w2)
-									)
-							};
-							if (zBufferValue >= m_pDepthBufferPixels[px + (py * m_Width)]) continue;
-							if(mesh.GetEffect()->GetEffectType() == EffectType::Diffuse) m_pDepthBufferPixels[px + (py * m_Width)] = zBufferValue;
-
-							ColorRGB finalColor{};
-							if (renderInfo.visualizeDepthBuffer)
-							{
-								const float remappedDepth{ Remap(zBufferValue, 0.995f, 1.f) };
-								finalColor = { remappedDepth, remappedDepth, remappedDepth };
-
-								//Update Color in Buffer
-								finalColor.MaxToOne();
-
-								m_pBackBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBackBuffer->format,
-									static_cast<uint8_t>(finalColor.r * 255),
-									static_cast<uint8_t>(finalColor.g * 255),
-									static_cast<uint8_t>(finalColor.b * 255));
-								continue;
-							}
-
-							Vertex_Out pixelVertex = Vertex_Out::Interpolate({ verticesOut[i0], verticesOut[i1], verticesOut[i2] }, w0, w1, w2);
-
-							uint8_t r, g, b;
-							SDL_GetRGB(m_pBackBufferPixels[(px + (py * m_Width))], m_pBackBuffer->format, &r, &g, &b);
-							finalColor = ShadePixel(mesh, pixelVertex, renderInfo, ColorRGB{ static_cast<float>(r) / 255.f, static_cast<float>(g) / 255.f, static_cast<float>(b) / 255.f });
-
-							//Update Color in Buffer
-							finalColor.MaxToOne();
-
-							m_pBackBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBackBuffer->format,
-								static_cast<uint8_t>(finalColor.r * 255),
-								static_cast<uint8_t>(finalColor.g * 255),
-								static_cast<uint8_t>(finalColor.b * 255));
-						}
+						texel.accumColor += color * (alpha * texel.revealage);
+						texel.revealage *= 1.f - alpha;
+						if (texel.revealage < saturatedTransmittance) --numOpenPixels;
 					}
-				});
+					else
+					{
+						// Nearer surfaces weigh more (equation 10 of the paper, on the view space depth)
+						const float weight{ alpha * std::clamp(0.03f / (1e-5f + Square(Square(viewDepth / 200.f))), 0.01f, 3000.f) };
+
+						texel.accumColor += color * (alpha * weight);
+						texel.accumAlpha += alpha * weight;
+						texel.revealage *= 1.f - alpha;
+					}
+				}
+			}
 		}
-		else
+
+		for (int py{ minY }; py < maxY; ++py)
 		{
-			for (int i = 0; i < indices.size() - 2; primitiveTopology == PrimitiveTopology::TriangleList ? i += 3 : i++)
+			for (int px{ minX }; px < maxX; ++px)
 			{
-				const int i0 = indices[i];
-				int i1 = indices[i + 1];
-				int i2 = indices[i + 2];
+				const uint32_t pixelIndex{ GetPixelIndex(px, py) };
+				const OITTexel& texel{ m_OITBuffer[pixelIndex] };
+				if (texel.revealage >= 1.f) continue;
 
-				if (i0 == i1 || i1 == i2) continue;
+				const ColorRGB& background{ m_ColorBuffer[pixelIndex] };
 
-				// swap index1 and index2 for odd triangles (ccw to cw)
-				if ((i & 1) == 1 && primitiveTopology == PrimitiveTopology::TriangleStrip)
+				ColorRGB finalColor{};
+				if constexpr (mode == TransparencyMode::SortedTiles)
 				{
-					std::swap(i1, i2);
+					finalColor = texel.accumColor + background * texel.revealage;
 				}
-
-				// CULLING
-				if (
-					verticesOut[i0].position.x < -1 || verticesOut[i0].position.x > 1 ||
-					verticesOut[i0].position.y < -1 || verticesOut[i0].position.y > 1 ||
-					verticesOut[i0].position.z < 0 || verticesOut[i0].position.z > 1 ||
-					verticesOut[i1].position.x < -1 || verticesOut[i1].position.x > 1 ||
-					verticesOut[i1].position.y < -1 || verticesOut[i1].position.y > 1 ||
-					verticesOut[i1].position.z < 0 || verticesOut[i1].position.z > 1 ||
-					verticesOut[i2].position.x < -1 || verticesOut[i2].position.x > 1 ||
-					verticesOut[i2].position.y < -1 || verticesOut[i2].position.y > 1 ||
-					verticesOut[i2].position.z < 0 || verticesOut[i2].position.z > 1
-					&& renderInfo.useFastCulling) continue;
-
-				// PROJECTION to SS / RASTER
-				const Vector2 v0{ (verticesOut[i0].position.x + 1) * 0.5f * m_Width, (1 - verticesOut[i0].position.y) * 0.5f * m_Height };
-				const Vector2 v1{ (verticesOut[i1].position.x + 1) * 0.5f * m_Width, (1 - verticesOut[i1].position.y) * 0.5f * m_Height };
-				const Vector2 v2{ (verticesOut[i2].position.x + 1) * 0.5f * m_Width, (1 - verticesOut[i2].position.y) * 0.5f * m_Height };
-
-				const Vector2 v0v1 = v1 - v0;
-				const Vector2 v0v2 = v2 - v0;
-				const Vector2 v1v2 = v2 - v1;
-				const Vector2 v2v0 = v0 - v2;
-
-				const float invTriArea = 1.f / Vector2::Cross(v0v1, v0v2);
-
-				Bounds aabb;
-				aabb.min.x = static_cast<float>(std::clamp(static_cast<int>(std::ceilf(std::min(v0.x, std::min(v1.x, v2.x)))), 0, m_Width - 1));
-				aabb.min.y = static_cast<float>(std::clamp(static_cast<int>(std::ceilf(std::min(v0.y, std::min(v1.y, v2.y)))), 0, m_Height - 1));
-				aabb.max.x = static_cast<float>(std::clamp(static_cast<int>(std::ceilf(std::max(v0.x, std::max(v1.x, v2.x)))), 0, m_Width - 1));
-				aabb.max.y = static_cast<float>(std::clamp(static_cast<int>(std::ceilf(std::max(v0.y, std::max(v1.y, v2.y)))), 0, m_Height - 1));
-
-				// SHADING LOGIC
-				for (uint32_t px{ static_cast<uint32_t>(aabb.min.x) }; px < aabb.max.x; ++px)
+				else
 				{
-					for (uint32_t py{ static_cast<uint32_t>(aabb.min.y) }; py < aabb.max.y; ++py)
-					{
-						if (renderInfo.visualizeBoundingBox)
-						{
-							ColorRGB finalColor = { 1, 1, 1 };
-
-							//Update Color in Buffer
-							finalColor.MaxToOne();
-
-							m_pBackBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBackBuffer->format,
-								static_cast<uint8_t>(finalColor.r * 255),
-								static_cast<uint8_t>(finalColor.g * 255),
-								static_cast<uint8_t>(finalColor.b * 255));
-
-							continue;
-						}
+					const ColorRGB averageColor{ texel.accumColor / std::max(texel.accumAlpha, 1e-5f) };
+					finalColor = ColorRGB::Lerp(averageColor, background, texel.revealage);
+				}
 
-						const Vector2 pixelPos{ static_cast<float>(px), static_cast<float>(py) };
+				//Update Color in Buffer
+				m_ColorBuffer[pixelIndex] = finalColor;
+			}
+		}
+	}
 
-						const Vector2 v1p = pixelPos - v1;
-						float w0 = Vector2::Cross(v1v2, v1p);
+	template<size_t index>
+	constexpr Renderer::ResolveTileFunc Renderer::GetResolveTile()
+	{
+		constexpr bool useFastShading{ (index % 2) == 1 };
+		constexpr bool useNormalMap{ ((index / 2) % 2) == 1 };
+		constexpr ShadingMode shadingMode{ static_cast<ShadingMode>((index / 4) % static_cast<size_t>(ShadingMode::SIZE)) };
+		constexpr bool fromVisibilityBuffer{ index / (4 * static_cast<size_t>(ShadingMode::SIZE)) == 1 };
 
-						const Vector2 v2p = pixelPos - v2;
-						float w1 = Vector2::Cross(v2v0, v2p);
+		if constexpr (fromVisibilityBuffer)
+			return &Renderer::ResolveTile<PixelOutput::VisibilityBuffer, shadingMode, useNormalMap, useFastShading>;
+		else
+			return &Renderer::ResolveTile<PixelOutput::GBuffer, shadingMode, useNormalMap, useFastShading>;
+	}
 
-						const Vector2 v0p = pixelPos - v0;
-						float w2 = Vector2::Cross(v0v1, v0p);
+	template<size_t... indices>
+	constexpr std::array<Renderer::ResolveTileFunc, sizeof...(indices)> Renderer::MakeResolveTileTable(std::index_sequence<indices...>)
+	{
+		return { GetResolveTile<indices>()... };
+	}
 
-						const bool isFrontFace{ w0 >= 0.f && w1 >= 0.f && w2 >= 0.f };
-						const bool isBackFace{ w0 < 0.f && w1 < 0.f && w2 < 0.f };
-						if (isFrontFace && cullMode == CullMode::FrontFace) continue;
-						if (isBackFace && cullMode == CullMode::BackFace) continue;
-						if (!isFrontFace && !isBackFace) continue;
+	void Renderer::ResolveDeferred(PixelOutput source, const RenderInfo& renderInfo) const
+	{
+		constexpr size_t numVariants{ 2 * static_cast<size_t>(ShadingMode::SIZE) * 2 * 2 };
+		static constexpr std::array<ResolveTileFunc, numVariants> resolveTileTable{ MakeResolveTileTable(std::make_index_sequence<numVariants>{}) };
+
+		// Same layout as GetResolveTile decodes
+		size_t index{ static_cast<size_t>(source == PixelOutput::VisibilityBuffer) };
+		index = index * static_cast<size_t>(ShadingMode::SIZE) + static_cast<size_t>(renderInfo.shadingMode);
+		index = index * 2 + static_cast<size_t>(renderInfo.useNormalMap);
+		index = index * 2 + static_cast<size_t>(renderInfo.useFastShading);
+		const ResolveTileFunc pResolveTile{ resolveTileTable[index] };
+
+		const int numTilesX{ (m_Width + m_TileSize - 1) / m_TileSize };
+		const int numTilesY{ (m_Height + m_TileSize - 1) / m_TileSize };
+		const auto resolveTile = [&](int tile)
+		{
+			// No opaque triangle touched the tile, it keeps the clear color
+			if (m_TileClearStates[tile] != TileClearState::Cleared) return;
 
-						w0 *= invTriArea;
-						w1 *= invTriArea;
-						w2 *= invTriArea;
+			const int minX{ (tile % numTilesX) * m_TileSize };
+			const int minY{ (tile / numTilesX) * m_TileSize };
+			(this->*pResolveTile)(minX, minY, std::min(minX + m_TileSize, m_Width), std::min(minY + m_TileSize, m_Height));
+		};
 
-						// Depth test
-						const float zBufferValue
-						{
-							1.f / (
-								((1.f / verticesOut[i0].position.z) * w0) +
-								((1.f / verticesOut[i1].position.z) * w1) +
-								((1.f / verticesOut[i2].position.z) * w2)
-								)
-						};
-						if (zBufferValue >= m_pDepthBufferPixels[px + (py * m_Width)]) continue;
-						if (mesh.GetEffect()->GetEffectType() == EffectType::Diffuse) m_pDepthBufferPixels[px + (py * m_Width)] = zBufferValue;
-
-						ColorRGB finalColor{};
-						if (renderInfo.visualizeDepthBuffer)
-						{
-							const float remappedDepth{ Remap(zBufferValue, 0.995f, 1.f) };
-							finalColor = { remappedDepth, remappedDepth, remappedDepth };
+		if (renderInfo.useMultiThreading)
+		{
+			m_pJobSystem->ParallelFor(0, numTilesX * numTilesY, resolveTile);
+		}
+		else
+		{
+			for (int tile = 0; tile < numTilesX * numTilesY; ++tile)
+			{
+				resolveTile(tile);
+			}
+		}
+	}
 
-							//Update Color in Buffer
-							finalColor.MaxToOne();
+	template<Renderer::PixelOutput source, ShadingMode shadingMode, bool useNormalMap, bool useFastShading>
+	void Renderer::ResolveTile(int minX, int minY, int maxX, int maxY) const
+	{
+		const uint32_t farDepth{ GetFarDepthKey() };
+		for (int py{ minY }; py < maxY; ++py)
+		{
+			for (int px{ minX }; px < maxX; ++px)
+			{
+				const uint32_t pixelIndex{ GetPixelIndex(px, py) };
 
-							m_pBackBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBackBuffer->format,
-								static_cast<uint8_t>(finalColor.r * 255),
-								static_cast<uint8_t>(finalColor.g * 255),
-								static_cast<uint8_t>(finalColor.b * 255));
-							continue;
-						}
+				// Nothing opaque got rasterized here, keep the clear color
+				if (LoadDepth(pixelIndex) >= farDepth) continue;
 
-						Vertex_Out pixelVertex = Vertex_Out::Interpolate({ verticesOut[i0], verticesOut[i1], verticesOut[i2] }, w0, w1, w2);
+				Mesh* pMesh;
+				Vertex_Out pixelVertex{};
+				if constexpr (source == PixelOutput::VisibilityBuffer)
+				{
+					const uint32_t primitiveId{ m_VisibilityBuffer[pixelIndex] };
+					pMesh = m_pFrameMeshes[primitiveId >> m_TriangleIdBits];
 
-						uint8_t r, g, b;
-						SDL_GetRGB(m_pBackBufferPixels[(px + (py * m_Width))], m_pBackBuffer->format, &r, &g, &b);
-						finalColor = ShadePixel(mesh, pixelVertex, renderInfo, ColorRGB{static_cast<float>(r) / 255.f, static_cast<float>(g) / 255.f, static_cast<float>(b) / 255.f });
+					const Vector2 pixelPos{ static_cast<float>(px), static_cast<float>(py) };
+					pixelVertex = ReconstructVertex(*pMesh, primitiveId & m_TriangleIdMask, pixelPos);
+				}
+				else
+				{
+					const GBufferTexel& texel{ m_GBuffer[pixelIndex] };
+					pMesh = m_pFrameMeshes[texel.meshId];
+
+					pixelVertex.normal = texel.normal;
+					pixelVertex.tangent = texel.tangent;
+					pixelVertex.viewDirection = texel.viewDirection;
+					pixelVertex.uv = texel.uv;
+					pixelVertex.uvLod = texel.uvLod;
+				}
 
-						//Update Color in Buffer
-						finalColor.MaxToOne();
+				ColorRGB finalColor{ ShadePixel<EffectType::Diffuse, shadingMode, useNormalMap, useFastShading>(*pMesh, pixelVertex, {}) };
 
-						m_pBackBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBackBuffer->format,
-							static_cast<uint8_t>(finalColor.r * 255),
-							static_cast<uint8_t>(finalColor.g * 255),
-							static_cast<uint8_t>(finalColor.b * 255));
-					}
-				}
+				//Update Color in Buffer
+				m_ColorBuffer[pixelIndex] = finalColor;
 			}
 		}
 	}
@@ -483,7 +1864,7 @@ namespace dae {
 				w1 *= invTriArea;
 				w2 *= invTriArea;
 
-				Vertex_Out newVert = Vertex_Out::Interpolate({ verticesOut[i0], verticesOut[i1], verticesOut[i2] }, w0, w1, w2, true);
+				Vertex_Out newVert = Vertex_Out::Interpolate(verticesOut[i0], verticesOut[i1], verticesOut[i2], w0, w1, w2, true);
 
 				newVert.position.x = vertexPos.x;
 				newVert.position.y = vertexPos.y;
@@ -597,7 +1978,8 @@ namespace dae {
 		return true;
 	}
 
-	ColorRGB Renderer::ShadePixel(const Mesh& mesh, const Vertex_Out& vertex, const RenderInfo& renderInfo, const ColorRGB& currPixelColor) const
+	template<EffectType effectType, ShadingMode shadingMode, bool useNormalMap, bool useFastShading>
+	ColorRGB Renderer::ShadePixel(const Mesh& mesh, const Vertex_Out& vertex, const ColorRGB& currPixelColor) const
 	{
 		// Light
 		const Vector3 lightDirection{ .577f, -.577f, 0.577f };
@@ -610,62 +1992,61 @@ namespace dae {
 		// Transparent material
 		// Lerp current color in backbuffer with this material
 		// Source: https://magcius.github.io/xplain/article/rast1.html
-		if (mesh.GetEffect()->GetEffectType() == EffectType::Transparent)
+		if constexpr (effectType == EffectType::Transparent)
 		{
 			// Lambert
-			const Vector4 diffuseAlpha{ mesh.GetDiffuseMap()->SampleRGBA(vertex.uv) };
+			const Vector4 diffuseAlpha{ mesh.GetDiffuseMap()->SampleRGBA(vertex.uv, vertex.uvLod) };
 			if(diffuseAlpha.w <= 0.01f) return currPixelColor;
 
 			const ColorRGB diffuse{ diffuseAlpha.x, diffuseAlpha.y, diffuseAlpha.z };
 			return ColorRGB::Lerp(currPixelColor, diffuse, diffuseAlpha.w);
 		}
-
-		Vector3 sampled_normal{ vertex.normal };
-		if (renderInfo.useNormalMap)
-		{
-			const Vector3 binormal{ Vector3::Cross(vertex.normal, vertex.tangent) };
-			const Matrix tangent_space_axis{ vertex.tangent, binormal, vertex.normal, {0.f, 0.f, 0.f} };
-			sampled_normal = 2.f * mesh.GetNormalMap()->SampleNormal(vertex.uv) - Vector3{ 1.f, 1.f, 1.f };
-			sampled_normal = tangent_space_axis.TransformVector(sampled_normal);
-		}
-
-		sampled_normal.Normalize();
-		const float observed_area{ std::max(0.f, Vector3::Dot(sampled_normal, -lightDirection)) };
-
-		switch (renderInfo.shadingMode)
+		else
 		{
-			case dae::ShadingMode::FinalColor:
+			Vector3 sampled_normal{ vertex.normal };
+			if constexpr (useNormalMap)
 			{
-				// Lambert
-				const ColorRGB lambert_diffuse{ (mesh.GetDiffuseMap()->SampleColor(vertex.uv) * kd) / PI };
+				const Vector3 binormal{ Vector3::Cross(vertex.normal, vertex.tangent) };
+				const Matrix tangent_space_axis{ vertex.tangent, binormal, vertex.normal, {0.f, 0.f, 0.f} };
+				sampled_normal = 2.f * mesh.GetNormalMap()->SampleNormal(vertex.uv, vertex.uvLod) - Vector3{ 1.f, 1.f, 1.f };
+				sampled_normal = tangent_space_axis.TransformVector(sampled_normal);
+			}
 
-				// Phong
-				const float exp{ mesh.GetGlossMap()->SampleColor(vertex.uv).r * shininess };
-				ColorRGB phong_color{ mesh.GetSpecularMap()->SampleColor(vertex.uv) * LightUtils::PhongSpecular(1.f, exp, lightDirection, vertex.viewDirection, sampled_normal) };
+			if constexpr (useFastShading) FastMath::Normalize(sampled_normal);
+			else sampled_normal.Normalize();
+			const float observed_area{ std::max(0.f, Vector3::Dot(sampled_normal, -lightDirection)) };
 
-				return (lambert_diffuse * lightIntensity + phong_color) * observed_area + ambient;
-			}
-			case dae::ShadingMode::ObservedArea:
+			if constexpr (shadingMode == ShadingMode::ObservedArea)
 			{
 				return { observed_area, observed_area, observed_area };
 			}
-			case dae::ShadingMode::Specular:
-			{
-				// Phong
-				const float exp{ mesh.GetGlossMap()->SampleColor(vertex.uv).r * shininess };
-				ColorRGB phong_color{ mesh.GetSpecularMap()->SampleColor(vertex.uv) * LightUtils::PhongSpecular(1.f, exp, lightDirection, vertex.viewDirection, sampled_normal) };
-
-				return phong_color * observed_area;
-			}
-			case dae::ShadingMode::Diffuse:
+			else if constexpr (shadingMode == ShadingMode::Diffuse)
 			{
 				// Lambert
-				const ColorRGB lambert_diffuse{ (mesh.GetDiffuseMap()->SampleColor(vertex.uv) * kd) / PI };
+				const ColorRGB lambert_diffuse{ (mesh.GetDiffuseMap()->SampleColor(vertex.uv, vertex.uvLod) * kd) / PI };
 				return lambert_diffuse * lightIntensity * observed_area;
 			}
-		}
+			else
+			{
+				// Phong
+				const float exp{ mesh.GetGlossMap()->SampleColor(vertex.uv, vertex.uvLod).r * shininess };
+				float phong_specular;
+				if constexpr (useFastShading) phong_specular = LightUtils::PhongSpecularFast(1.f, exp, lightDirection, vertex.viewDirection, sampled_normal);
+				else phong_specular = LightUtils::PhongSpecular(1.f, exp, lightDirection, vertex.viewDirection, sampled_normal);
+				const ColorRGB phong_color{ mesh.GetSpecularMap()->SampleColor(vertex.uv, vertex.uvLod) * phong_specular };
 
-		return ColorRGB{};
+				if constexpr (shadingMode == ShadingMode::Specular)
+				{
+					return phong_color * observed_area;
+				}
+				else
+				{
+					// Lambert
+					const ColorRGB lambert_diffuse{ (mesh.GetDiffuseMap()->SampleColor(vertex.uv, vertex.uvLod) * kd) / PI };
+					return (lambert_diffuse * lightIntensity + phong_color) * observed_area + ambient;
+				}
+			}
+		}
 	}
 #pragma endregion
 
@@ -680,11 +2061,17 @@ namespace dae {
 		create_device_flags |= D3D11_CREATE_DEVICE_DEBUG;
 #endif // DEBUG
 
-		HRESULT result = D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_HARDWARE, 0, create_device_flags, &feature_level,
+		// Headless machines may have no GPU, WARP is the CPU implementation that ships with Windows
+		const D3D_DRIVER_TYPE driver_type{ m_pWindow ? D3D_DRIVER_TYPE_HARDWARE : D3D_DRIVER_TYPE_WARP };
+		HRESULT result = D3D11CreateDevice(nullptr, driver_type, 0, create_device_flags, &feature_level,
 			1, D3D11_SDK_VERSION, &m_pDevice, nullptr, &m_pDeviceContext);
 		if (FAILED(result))
 			return result;
 
+		// Without a window there is nothing to present to, the device only backs the scene's meshes, effects and textures
+		if (!m_pWindow)
+			return result;
+
 		// Create DXGI Factory
 		IDXGIFactory1* pdxgi_factory{};
 		result = CreateDXGIFactory1(__uuidof(IDXGIFactory1), reinterpret_cast<void**>(&pdxgi_factory));
@@ -693,8 +2080,8 @@ namespace dae {
 
 		// 2. Create SwapChain
 		DXGI_SWAP_CHAIN_DESC swap_chain_desc{};
-		swap_chain_desc.BufferDesc.Width = m_Width;
-		swap_chain_desc.BufferDesc.Height = m_Height;
+		swap_chain_desc.BufferDesc.Width = m_WindowWidth;
+		swap_chain_desc.BufferDesc.Height = m_WindowHeight;
 		swap_chain_desc.BufferDesc.RefreshRate.Numerator = 1;
 		swap_chain_desc.BufferDesc.RefreshRate.Denominator = 144;
 		swap_chain_desc.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
@@ -722,8 +2109,8 @@ namespace dae {
 		// 3. Create DepthStencil (DS) & DepthStencilView (DSV)
 		// Resource (Buffer)
 		D3D11_TEXTURE2D_DESC depth_stencil_desc{};
-		depth_stencil_desc.Width = m_Width;
-		depth_stencil_desc.Height = m_Height;
+		depth_stencil_desc.Width = m_WindowWidth;
+		depth_stencil_desc.Height = m_WindowHeight;
 		depth_stencil_desc.MipLevels = 1;
 		depth_stencil_desc.ArraySize = 1;
 		depth_stencil_desc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
@@ -767,8 +2154,8 @@ namespace dae {
 
 		// 6. Set the viewport
 		D3D11_VIEWPORT viewport{};
-		viewport.Width = static_cast<float>(m_Width);
-		viewport.Height = static_cast<float>(m_Height);
+		viewport.Width = static_cast<float>(m_WindowWidth);
+		viewport.Height = static_cast<float>(m_WindowHeight);
 		viewport.TopLeftX = 0.f;
 		viewport.TopLeftY = 0.f;
 		viewport.MinDepth = 0.f;
@@ -785,7 +2172,7 @@ namespace dae {
 		// 1. Clear RTV & DSV
 		ColorRGB clearColor{ renderInfo.clearColor };
 		m_pDeviceContext->ClearRenderTargetView(m_pRenderTargetView, &clearColor.r);
-		m_pDeviceContext->ClearDepthStencilView(m_pDepthStencilView, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.f, 0);
+		m_pDeviceContext->ClearDepthStencilView(m_pDepthStencilView, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, renderInfo.useReverseZ ? 0.f : 1.f, 0);
 
 		// 2. Set pipeline + invoke drawcalls
 		std::for_each(begin(pMeshes), end(pMeshes), [&](std::shared_ptr<Mesh>& mesh)
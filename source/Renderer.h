@@ -1,5 +1,14 @@
 #pragma once
 #include "pch.h"
+#include "JobSystem.h"
+#include "FrameBuffer.h"
+#include <array>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
 
 struct SDL_Window;
 struct SDL_Surface;
@@ -10,7 +19,9 @@ namespace dae
 	class Renderer final
 	{
 	public:
-		Renderer(SDL_Window* pWindow);
+		Renderer(SDL_Window* pWindow, JobSystem* pJobSystem);
+		// Headless: software rendering only, into an owned width x height frame. Needs no display and no GPU
+		Renderer(int width, int height, JobSystem* pJobSystem);
 		~Renderer();
 
 		Renderer(const Renderer&) = delete;
@@ -18,46 +29,379 @@ namespace dae
 		Renderer& operator=(const Renderer&) = delete;
 		Renderer& operator=(Renderer&&) noexcept = delete;
 
+		// With RenderInfo::useFramePipelining the software frame is only started here and rasterizes on the job system,
+		// while the previous frame gets presented and the next scene update runs
 		void Render(Scene* pScene);
 
+		// Blocks until the software frame in flight is done, textures it samples can only change after this
+		void WaitForFrame();
+
+		// Writes the last software frame as a BMP, at the window (or headless) size
+		bool SaveFrame(const std::string& path);
+
+		// One rate per m_TileSize x m_TileSize window tile, row by row, used by ShadingRatePolicy::RateImage
+		void SetShadingRateImage(const std::vector<ShadingRate>& tileRates);
+
+		// Dynamic resolution: feeds the last frame time to the controller, which picks the software render scale for the next frame
+		void UpdateResolutionScale(float elapsedSec, const RenderInfo& renderInfo);
+		float GetRenderScale() const { return m_PendingRenderScale; }
+
 		ID3D11Device* GetDevice() const { return m_pDevice; }
 		ID3D11DeviceContext* GetDeviceContext() const{ return m_pDeviceContext; }
 
 	private:
 		// Common
 		SDL_Window* m_pWindow{};
+		JobSystem* m_pJobSystem{};
 		bool m_IsInitialized{ false };
 
+		// Software render resolution, at most the window size. All software buffers are allocated for the window
+		// size, so changing the resolution never reallocates them. The back buffer is linear with m_Width as its stride,
+		// the frame buffers are tile-major (see FrameBuffer) with the tile grid of the render size.
+		// Frames are presented straight from the window surface (see FinishFrame), the back buffer is only the upscale source
 		int m_Width{};
 		int m_Height{};
+		int m_WindowWidth{};
+		int m_WindowHeight{};
 		
 		// Software
 		SDL_Surface* m_pFrontBuffer{ nullptr };
 		SDL_Surface* m_pBackBuffer{ nullptr };
 		uint32_t* m_pBackBufferPixels{};
+		bool m_CanPresentDirectly{ false }; // The window surface is 32 bit, so the software buffers share its format
+
+		// Every software pass draws into the tiled color buffer, it gets swizzled into the window surface at the end of the frame.
+		// Colors stay linear floats until then, the swizzle tonemaps and packs them to the surface format 4 pixels at a time
+		static constexpr int m_TileSize{ 64 };
+		template<typename T>
+		using TiledBuffer = FrameBuffer<T, m_TileSize>;
+		TiledBuffer<ColorRGB> m_ColorBuffer{};
+		// All frame buffers share one layout
+		uint32_t GetPixelIndex(int px, int py) const { return m_ColorBuffer.GetIndex(px, py); }
+
+		// Depth is stored as an unsigned key that orders like the depth itself: unorm for D16 and D24, the float bits for D32
+		// (positive floats order the same as their bit patterns). D16 keys live in their own buffer at half the bandwidth.
+		// Reverse-Z stores the keys mirrored, so a smaller key is nearer either way and every depth test stays a less-than
+		DepthFormat m_DepthFormat{ DepthFormat::D32 };
+		bool m_IsReverseZ{ false };
+		TiledBuffer<uint32_t> m_DepthBuffer{};
+		TiledBuffer<uint16_t> m_DepthBuffer16{};
+
+		// The pixel loops get the format and the reverse-Z flag as template parameters, so a depth test is a compare and no branches.
+		// The runtime versions below dispatch to these for the code that runs once per pixel at most
+		template<DepthFormat depthFormat>
+		static constexpr uint32_t GetFarDepthKey()
+		{
+			if constexpr (depthFormat == DepthFormat::D16) return 65535;
+			else if constexpr (depthFormat == DepthFormat::D24) return 16777215;
+			else return 0x3F800000;
+		}
+		template<DepthFormat depthFormat, bool isReverseZ>
+		static uint32_t EncodeDepth(float depth)
+		{
+			const float clampedDepth{ std::clamp(depth, 0.f, 1.f) };
+			uint32_t depthKey;
+			if constexpr (depthFormat == DepthFormat::D16) depthKey = static_cast<uint32_t>(clampedDepth * 65535.f + 0.5f);
+			else if constexpr (depthFormat == DepthFormat::D24) depthKey = static_cast<uint32_t>(clampedDepth * 16777215.f + 0.5f);
+			else std::memcpy(&depthKey, &clampedDepth, sizeof(float));
+
+			if constexpr (isReverseZ) return GetFarDepthKey<depthFormat>() - depthKey;
+			else return depthKey;
+		}
+		template<DepthFormat depthFormat, bool isReverseZ>
+		static float DecodeDepth(uint32_t depthKey)
+		{
+			if constexpr (isReverseZ) depthKey = GetFarDepthKey<depthFormat>() - depthKey;
+			if constexpr (depthFormat == DepthFormat::D16) return static_cast<float>(depthKey) / 65535.f;
+			else if constexpr (depthFormat == DepthFormat::D24) return static_cast<float>(depthKey) / 16777215.f;
+			else
+			{
+				float depth;
+				std::memcpy(&depth, &depthKey, sizeof(float));
+				return depth;
+			}
+		}
+		template<DepthFormat depthFormat>
+		uint32_t LoadDepth(uint32_t pixelIndex) const
+		{
+			if constexpr (depthFormat == DepthFormat::D16) return m_DepthBuffer16[pixelIndex];
+			else return m_DepthBuffer[pixelIndex];
+		}
+		template<DepthFormat depthFormat>
+		void StoreDepth(uint32_t pixelIndex, uint32_t depthKey) const
+		{
+			if constexpr (depthFormat == DepthFormat::D16) m_DepthBuffer16[pixelIndex] = static_cast<uint16_t>(depthKey);
+			else m_DepthBuffer[pixelIndex] = depthKey;
+		}
+
+		// Calls func(depthFormat, isReverseZ) with the frame's depth settings as std::integral_constant arguments
+		template<typename Func>
+		decltype(auto) DispatchDepth(Func&& func) const
+		{
+			const auto dispatchReverseZ = [&](auto depthFormat) -> decltype(auto)
+			{
+				if (m_IsReverseZ) return func(depthFormat, std::true_type{});
+				return func(depthFormat, std::false_type{});
+			};
+			switch (m_DepthFormat)
+			{
+			case DepthFormat::D16: return dispatchReverseZ(std::integral_constant<DepthFormat, DepthFormat::D16>{});
+			case DepthFormat::D24: return dispatchReverseZ(std::integral_constant<DepthFormat, DepthFormat::D24>{});
+			default: return dispatchReverseZ(std::integral_constant<DepthFormat, DepthFormat::D32>{});
+			}
+		}
+
+		uint32_t EncodeDepth(float depth) const
+		{
+			return DispatchDepth([&](auto depthFormat, auto isReverseZ) { return EncodeDepth<decltype(depthFormat)::value, decltype(isReverseZ)::value>(depth); });
+		}
+		float DecodeDepth(uint32_t depthKey) const
+		{
+			return DispatchDepth([&](auto depthFormat, auto isReverseZ) { return DecodeDepth<decltype(depthFormat)::value, decltype(isReverseZ)::value>(depthKey); });
+		}
+		// Largest key, depth 1 or with reverse-Z depth 0. The far plane, what a cleared pixel holds
+		uint32_t GetFarDepthKey() const
+		{
+			return DispatchDepth([](auto depthFormat, auto) { return GetFarDepthKey<decltype(depthFormat)::value>(); });
+		}
+		// Projected depth back in the standard convention, 0 at the near plane and 1 at the far plane
+		float GetStandardDepth(uint32_t depthKey) const
+		{
+			const float depth{ DecodeDepth(depthKey) };
+			return m_IsReverseZ ? 1.f - depth : depth;
+		}
+
+		uint32_t LoadDepth(uint32_t pixelIndex) const
+		{
+			return m_DepthFormat == DepthFormat::D16 ? LoadDepth<DepthFormat::D16>(pixelIndex) : LoadDepth<DepthFormat::D32>(pixelIndex);
+		}
+		void StoreDepth(uint32_t pixelIndex, uint32_t depthKey) const
+		{
+			if (m_DepthFormat == DepthFormat::D16) StoreDepth<DepthFormat::D16>(pixelIndex, depthKey);
+			else StoreDepth<DepthFormat::D32>(pixelIndex, depthKey);
+		}
+
+		// Hierarchical depth: nearest and farthest depth key of every tile. A triangle that starts behind the farthest
+		// depth of a tile can't pass a single depth test in it, the nearest depth feeds the distance based shading rates.
+		// Refreshed from the tile's depth once a pass that writes depth is done with the tile, so it never claims more than the buffer holds
+		struct TileDepthRange
+		{
+			uint32_t min;
+			uint32_t max;
+		};
+		std::vector<TileDepthRange> m_TileDepthRanges{};
+		void UpdateTileDepthRange(int tile);
+
+		// Deferred: only what the shading pass needs, valid wherever the depth buffer got written
+		struct GBufferTexel
+		{
+			Vector3 normal;
+			Vector3 tangent;
+			Vector3 viewDirection;
+			Vector2 uv;
+			float uvLod;
+			uint32_t meshId;
+		};
+		TiledBuffer<GBufferTexel> m_GBuffer{};
+
+		// Visibility buffer: (mesh id << m_TriangleIdBits) | triangle per pixel, attributes get rebuilt while shading.
+		// The split gets sized per frame, the mesh id takes as few bits as the mesh count needs and the triangles get the rest
+		TiledBuffer<uint32_t> m_VisibilityBuffer{};
+		uint32_t m_TriangleIdBits{ 24 };
+		uint32_t m_TriangleIdMask{ (1u << 24) - 1 };
+		bool m_IsIdSpaceExceeded{ false };
+		// Clipping against the screen keeps at most a 5 sided polygon, so a triangle turns into 3 at most
+		static constexpr uint32_t m_MaxClippedTriangles{ 3 };
+
+		// Transparent triangles set up once and binned per tile, each tile composites its own list so tiles run in parallel
+		struct BinnedTriangle
+		{
+			uint32_t meshId;
+			uint32_t i0, i1, i2;
+			Vector2 v0, v1, v2;
+			float invTriArea;
+			float invZ0, invZ1, invZ2;
+			float uvLod;
+			uint32_t nearestDepth;
+			int minX, minY, maxX, maxY;
+		};
+		struct OITTexel
+		{
+			ColorRGB accumColor;
+			float accumAlpha;
+			float revealage; // Also the remaining transmittance when compositing front to back
+		};
+		// 4x MSAA (forward only): per sample depth and color, samples of a pixel are contiguous so the resolve reads them in one go
+		static constexpr uint32_t m_NumSamples{ 4 };
+		static constexpr float m_SampleOffsets[m_NumSamples][2]{ { -0.125f, -0.375f }, { 0.375f, -0.125f }, { -0.375f, 0.125f }, { 0.125f, 0.375f } };
+		TiledBuffer<uint32_t> m_SampleDepthBuffer{};
+		TiledBuffer<ColorRGB> m_SampleColorBuffer{};
+
+		// Variable rate shading: the rate of every tile, picked at the start of the frame
+		std::vector<ShadingRate> m_TileShadingRates{};
+		std::vector<ShadingRate> m_ShadingRateImage{};
+		static constexpr float m_FlatGradient{ 0.01f };
+		static constexpr float m_SmoothGradient{ 0.03f };
+		static constexpr float m_NearShadingDistance{ 45.f };
+		static constexpr float m_FarShadingDistance{ 80.f };
+
+		std::vector<BinnedTriangle> m_BinnedTriangles{};
+		std::vector<std::vector<uint32_t>> m_TileBins{};
+		TiledBuffer<OITTexel> m_OITBuffer{};
 
-		float* m_pDepthBufferPixels{};
+		// Tiles get cleared by the first job that touches them in a frame. Tiles without triangles only clear their color,
+		// their depth (and MSAA samples) stay stale and every reader of the depth checks the state first
+		enum class TileClearState : uint8_t { Dirty, ColorCleared, Cleared };
+		std::vector<TileClearState> m_TileClearStates{};
+		ColorRGB m_ClearColor{};
+		bool m_ClearSamples{ false };
+		void ClearTile(int tile, bool needsDepth);
 
-		void RenderSoftware(std::vector<std::shared_ptr<Mesh>>& pMeshes, const Camera& camera, const RenderInfo& renderInfo);
+		// Dynamic resolution, render scale is the render size over the window size on both axes
+		static constexpr float m_FrameTimeBudget{ 0.033f };
+		static constexpr float m_MinRenderScale{ 0.5f };
+		static constexpr float m_RenderScaleStep{ 1.f / 16.f };
+		static constexpr int m_ScaleChangeCooldown{ 10 };
+		float m_RenderScale{ 1.f };
+		float m_PendingRenderScale{ 1.f }; // Applied between frames, never while one is in flight
+		float m_SmoothedFrameTime{};
+		int m_FramesSinceScaleChange{};
 
-		void ProjectMesh(std::shared_ptr<Mesh> mesh, const Camera& camera) const;
-		void RasterizeMesh(Mesh& mesh, const RenderInfo& renderInfo) const;
+		// Source rows/columns and 7 bit weight of every window pixel for the bilinear upscale
+		struct UpscaleTap
+		{
+			int index0, index1;
+			int weight;
+		};
+		std::vector<UpscaleTap> m_UpscaleColumns{};
+		std::vector<UpscaleTap> m_UpscaleRows{};
+		SDL_Surface* m_pUpscaleBuffer{ nullptr }; // Window sized frame for a window surface of another format, converted on present
+
+		// Frame pipelining: the frame in flight renders into the tile buffers while the finished frame gets presented.
+		// A pipelined frame stays in the tile buffers until the next Render call finishes it into the window surface,
+		// right before the next frame starts. A pipelined frame works on snapshots of the scene meshes so the scene can update meanwhile
+		struct FrameState
+		{
+			std::vector<Mesh*> pMeshes; // The enabled scene meshes, or their snapshots while pipelining
+			std::deque<Mesh> meshSnapshots; // Reused from frame to frame, only the transforms and projected vertices are their own
+			std::optional<Camera> camera; // Camera has const members, so it can only be copy constructed
+			RenderInfo renderInfo;
+		};
+		FrameState m_FrameState{};
+		JobCounter m_FrameInFlight{};
+		bool m_HasPipelinedFrame{ false };
+		SDL_Surface* m_pFinishedFrame{ nullptr };
+
+		// Meshes rasterized this frame (clipped copies live in m_ClippedMeshes), indexed by mesh id.
+		// Every mesh job only writes its own slots, so the meshes can be prepared concurrently
+		std::vector<Mesh*> m_pFrameMeshes{};
+		std::vector<std::unique_ptr<Mesh>> m_ClippedMeshes{};
+		// Triangles of every frame mesh that touch a tile, [mesh id][tile], in triangle order
+		std::vector<std::vector<std::vector<uint32_t>>> m_MeshTileBins{};
+
+		// Software buffers for a m_WindowWidth x m_WindowHeight frame, in the given 32 bit SDL pixel format
+		void InitializeSoftware(uint32_t pixelFormat);
+
+		void RenderSoftware(FrameState& frame);
+		// Sizes the visibility id split for the frame, falls back to forward when a mesh has more triangles than fit
+		void UpdateTriangleIdSplit(FrameState& frame);
+		// Swizzles (and upscales) the rendered frame into the surface that gets presented, m_pFinishedFrame
+		void FinishFrame(const RenderInfo& renderInfo);
+		void PresentSoftware(SDL_Surface* pFrame);
+
+		void ProjectMesh(Mesh& mesh, const Camera& camera, const RenderInfo& renderInfo) const;
+		// Projects, clips and bins one mesh, the first stage of the frame's task graph
+		void PrepareMesh(Mesh& mesh, uint32_t meshId, const Camera& camera, const RenderInfo& renderInfo);
+		void BinMesh(uint32_t meshId, const RenderInfo& renderInfo);
+		bool GetTriangleIndices(const Mesh& mesh, uint32_t triangle, uint32_t& i0, uint32_t& i1, uint32_t& i2) const;
+		bool IsOutsideFrustum(const Vertex_Out& v0, const Vertex_Out& v1, const Vertex_Out& v2, bool useFastCulling) const;
+		Vector2 ToScreenSpace(const Vector4& position) const;
+		Vertex_Out ReconstructVertex(Mesh& mesh, uint32_t triangle, const Vector2& pixelPos) const;
 
 		Mesh ClipMesh(Mesh& mesh);
 		bool ClipTriangle(std::vector<Vector2>& triVerts);
 
-		ColorRGB ShadePixel(const Mesh& mesh, const Vertex_Out& vertex, const RenderInfo& renderInfo, const ColorRGB& currPixelColor) const;
+		// The per pixel options are template parameters so every combination gets its own branch-free pixel loop,
+		// the matching instantiation is looked up once per mesh
+		enum class PixelOutput { Shade, Depth, BoundingBox, GBuffer, VisibilityBuffer, DepthPrepass, ShadeMultisampled, SIZE = 7 };
+		using RasterizeTriangleFunc = void (Renderer::*)(const Mesh&, const std::vector<Vertex_Out>&, uint32_t, uint32_t, uint32_t, uint32_t, const RenderInfo&, int, int, int, int) const;
+
+		// The meshes a pass draws (in scene order) with their rasterizer. A tile only ever writes its own pixels,
+		// so all tiles of a pass rasterize at once without racing on the depth or color buffers
+		using TilePass = std::vector<std::pair<uint32_t, RasterizeTriangleFunc>>;
+		void RasterizeTile(int tile, const TilePass& pass, const RenderInfo& renderInfo);
+		void RasterizeTiles(const TilePass& pass, const RenderInfo& renderInfo);
+
+		RasterizeTriangleFunc SelectRasterizeTriangle(const Mesh& mesh, const RenderInfo& renderInfo, bool isDepthPrepass) const;
+		template<size_t index>
+		static constexpr RasterizeTriangleFunc GetRasterizeTriangle();
+		template<size_t... indices>
+		static constexpr std::array<RasterizeTriangleFunc, sizeof...(indices)> MakeRasterizeTriangleTable(std::index_sequence<indices...>);
+
+		template<PixelOutput output, CullMode cullMode, EffectType effectType, ShadingMode shadingMode, bool useNormalMap, bool useFastShading, bool useDepthEqual,
+			DepthFormat depthFormat, bool isReverseZ>
+		void RasterizeTriangle(const Mesh& mesh, const std::vector<Vertex_Out>& verticesOut, uint32_t i0, uint32_t i1, uint32_t i2, uint32_t primitiveId, const RenderInfo& renderInfo,
+			int tileMinX, int tileMinY, int tileMaxX, int tileMaxY) const;
+
+		void BinTransparentMesh(Mesh& mesh, uint32_t meshId, const RenderInfo& renderInfo);
+		void CompositeTransparentTiles(const RenderInfo& renderInfo);
+		template<TransparencyMode mode, DepthFormat depthFormat, bool isReverseZ>
+		void CompositeTransparentTile(int tile, int minX, int minY, int maxX, int maxY);
+
+		// Shades every covered pixel of the G-buffer or visibility buffer once, tile by tile
+		using ResolveTileFunc = void (Renderer::*)(int, int, int, int) const;
+		void ResolveDeferred(PixelOutput source, const RenderInfo& renderInfo) const;
+		template<size_t index>
+		static constexpr ResolveTileFunc GetResolveTile();
+		template<size_t... indices>
+		static constexpr std::array<ResolveTileFunc, sizeof...(indices)> MakeResolveTileTable(std::index_sequence<indices...>);
+
+		template<PixelOutput source, ShadingMode shadingMode, bool useNormalMap, bool useFastShading>
+		void ResolveTile(int minX, int minY, int maxX, int maxY) const;
+
+		template<CullMode cullMode>
+		static bool IsInside(float w0, float w1, float w2);
+
+		// Averages the samples of every pixel into the color buffer and keeps the nearest sample depth
+		void ResolveMultisampled(const RenderInfo& renderInfo);
+		// Copies the tiled color buffer into linear pixels, tile by tile, packed to the back buffer format
+		void SwizzleColorBuffer(uint32_t* pPixels, int stride, const RenderInfo& renderInfo) const;
+
+		// Channel positions of the back buffer format, every 32 bit format has 8 bit channels
+		struct PixelPacking
+		{
+			int redShift, greenShift, blueShift;
+			uint32_t alphaMask;
+		};
+		PixelPacking m_PixelPacking{};
+		// Same as the swizzle: MaxToOne, then truncate to 8 bit per channel
+		uint32_t PackColor(ColorRGB color) const
+		{
+			color.MaxToOne();
+			const auto toChannel = [](float value) { return static_cast<uint32_t>(std::clamp(value, 0.f, 1.f) * 255.f); };
+			return (toChannel(color.r) << m_PixelPacking.redShift) | (toChannel(color.g) << m_PixelPacking.greenShift)
+				| (toChannel(color.b) << m_PixelPacking.blueShift) | m_PixelPacking.alphaMask;
+		}
+
+		// Reads the previous frame's color and depth, so it has to run before they get cleared
+		void UpdateShadingRates(const Camera& camera, const RenderInfo& renderInfo);
+
+		void SetRenderScale(float scale);
+		void UpscaleToWindow(SDL_Surface* pTarget, const RenderInfo& renderInfo) const;
+
+		template<EffectType effectType, ShadingMode shadingMode, bool useNormalMap, bool useFastShading>
+		ColorRGB ShadePixel(const Mesh& mesh, const Vertex_Out& vertex, const ColorRGB& currPixelColor) const;
 
 		// DirectX
 		HRESULT InitializeDirectX();
 		void RenderHardware(std::vector<std::shared_ptr<Mesh>>& pMeshes, const RenderInfo& renderInfo) const;
 
-		ID3D11Device* m_pDevice;
-		ID3D11DeviceContext* m_pDeviceContext;
-		IDXGISwapChain* m_pSwapChain;
-		ID3D11Texture2D* m_pDepthStencilBuffer;
-		ID3D11DepthStencilView* m_pDepthStencilView;
-		ID3D11Texture2D* m_pRenderTargetBuffer;
-		ID3D11RenderTargetView* m_pRenderTargetView;
+		ID3D11Device* m_pDevice{};
+		ID3D11DeviceContext* m_pDeviceContext{};
+		IDXGISwapChain* m_pSwapChain{};
+		ID3D11Texture2D* m_pDepthStencilBuffer{};
+		ID3D11DepthStencilView* m_pDepthStencilView{};
+		ID3D11Texture2D* m_pRenderTargetBuffer{};
+		ID3D11RenderTargetView* m_pRenderTargetView{};
 	};
 }
@@ -47,6 +47,39 @@ void dae::Scene::ProccesKeyInput(SDL_Event& e)
 	case SDL_SCANCODE_X:
 		ToggleMultiThreading();
 		break;
+	case SDL_SCANCODE_U:
+		CycleAddressMode();
+		break;
+	case SDL_SCANCODE_F:
+		ToggleFastShading();
+		break;
+	case SDL_SCANCODE_P:
+		CycleRenderPipeline();
+		break;
+	case SDL_SCANCODE_O:
+		ToggleDepthPrepass();
+		break;
+	case SDL_SCANCODE_T:
+		CycleTransparencyMode();
+		break;
+	case SDL_SCANCODE_M:
+		ToggleMSAA();
+		break;
+	case SDL_SCANCODE_V:
+		CycleShadingRatePolicy();
+		break;
+	case SDL_SCANCODE_R:
+		ToggleDynamicResolution();
+		break;
+	case SDL_SCANCODE_L:
+		ToggleFramePipelining();
+		break;
+	case SDL_SCANCODE_N:
+		CycleDepthFormat();
+		break;
+	case SDL_SCANCODE_K:
+		ToggleReverseZ();
+		break;
 	}
 }
 
@@ -176,6 +209,147 @@ void dae::Scene::ToggleMultiThreading()
 	m_RenderInfo.useMultiThreading ? std::cout << "ON\n" : std::cout << "OFF\n";
 }
 
+void dae::Scene::ToggleFastShading()
+{
+	if (m_RenderInfo.renderType != RenderType::Software) return;
+	m_RenderInfo.useFastShading = !m_RenderInfo.useFastShading;
+
+	SetConsoleTextAttribute(m_hConsole, 13);
+	std::cout << "[FAST SHADING] ";
+	m_RenderInfo.useFastShading ? std::cout << "ON\n" : std::cout << "OFF\n";
+}
+
+void dae::Scene::CycleRenderPipeline()
+{
+	if (m_RenderInfo.renderType != RenderType::Software) return;
+	m_RenderInfo.pipeline = static_cast<RenderPipeline>((static_cast<int>(m_RenderInfo.pipeline) + 1) % static_cast<int>(RenderPipeline::SIZE));
+
+	SetConsoleTextAttribute(m_hConsole, 13);
+	switch (m_RenderInfo.pipeline)
+	{
+	case dae::RenderPipeline::Forward:
+		std::cout << "[RENDER PIPELINE] Forward\n";
+		break;
+	case dae::RenderPipeline::Deferred:
+		std::cout << "[RENDER PIPELINE] Deferred\n";
+		break;
+	case dae::RenderPipeline::VisibilityBuffer:
+		std::cout << "[RENDER PIPELINE] Visibility Buffer\n";
+		break;
+	default:
+		break;
+	}
+}
+
+void dae::Scene::ToggleDepthPrepass()
+{
+	if (m_RenderInfo.renderType != RenderType::Software) return;
+	m_RenderInfo.useDepthPrepass = !m_RenderInfo.useDepthPrepass;
+
+	SetConsoleTextAttribute(m_hConsole, 13);
+	std::cout << "[DEPTH PREPASS] ";
+	m_RenderInfo.useDepthPrepass ? std::cout << "ON\n" : std::cout << "OFF\n";
+}
+
+void dae::Scene::CycleTransparencyMode()
+{
+	if (m_RenderInfo.renderType != RenderType::Software) return;
+	m_RenderInfo.transparencyMode = static_cast<TransparencyMode>((static_cast<int>(m_RenderInfo.transparencyMode) + 1) % static_cast<int>(TransparencyMode::SIZE));
+
+	SetConsoleTextAttribute(m_hConsole, 13);
+	switch (m_RenderInfo.transparencyMode)
+	{
+	case dae::TransparencyMode::Ordered:
+		std::cout << "[TRANSPARENCY] Ordered\n";
+		break;
+	case dae::TransparencyMode::WeightedBlended:
+		std::cout << "[TRANSPARENCY] Weighted Blended OIT\n";
+		break;
+	case dae::TransparencyMode::SortedTiles:
+		std::cout << "[TRANSPARENCY] Sorted Per Tile\n";
+		break;
+	default:
+		break;
+	}
+}
+
+void dae::Scene::ToggleMSAA()
+{
+	if (m_RenderInfo.renderType != RenderType::Software) return;
+	m_RenderInfo.useMSAA = !m_RenderInfo.useMSAA;
+
+	SetConsoleTextAttribute(m_hConsole, 13);
+	std::cout << "[MSAA 4X] ";
+	m_RenderInfo.useMSAA ? std::cout << "ON\n" : std::cout << "OFF\n";
+}
+
+void dae::Scene::CycleShadingRatePolicy()
+{
+	if (m_RenderInfo.renderType != RenderType::Software) return;
+	m_RenderInfo.shadingRatePolicy = static_cast<ShadingRatePolicy>((static_cast<int>(m_RenderInfo.shadingRatePolicy) + 1) % static_cast<int>(ShadingRatePolicy::SIZE));
+
+	SetConsoleTextAttribute(m_hConsole, 13);
+	switch (m_RenderInfo.shadingRatePolicy)
+	{
+	case dae::ShadingRatePolicy::Off:
+		std::cout << "[VARIABLE RATE SHADING] OFF\n";
+		break;
+	case dae::ShadingRatePolicy::LuminanceGradient:
+		std::cout << "[VARIABLE RATE SHADING] Luminance Gradient\n";
+		break;
+	case dae::ShadingRatePolicy::Distance:
+		std::cout << "[VARIABLE RATE SHADING] Distance\n";
+		break;
+	case dae::ShadingRatePolicy::RateImage:
+		std::cout << "[VARIABLE RATE SHADING] Rate Image\n";
+		break;
+	default:
+		break;
+	}
+}
+
+void dae::Scene::ToggleDynamicResolution()
+{
+	if (m_RenderInfo.renderType != RenderType::Software) return;
+	m_RenderInfo.useDynamicResolution = !m_RenderInfo.useDynamicResolution;
+
+	SetConsoleTextAttribute(m_hConsole, 13);
+	std::cout << "[DYNAMIC RESOLUTION] ";
+	m_RenderInfo.useDynamicResolution ? std::cout << "ON\n" : std::cout << "OFF\n";
+}
+
+void dae::Scene::ToggleFramePipelining()
+{
+	if (m_RenderInfo.renderType != RenderType::Software) return;
+	m_RenderInfo.useFramePipelining = !m_RenderInfo.useFramePipelining;
+
+	SetConsoleTextAttribute(m_hConsole, 13);
+	std::cout << "[FRAME PIPELINING] ";
+	m_RenderInfo.useFramePipelining ? std::cout << "ON\n" : std::cout << "OFF\n";
+}
+
+void dae::Scene::CycleDepthFormat()
+{
+	if (m_RenderInfo.renderType != RenderType::Software) return;
+	m_RenderInfo.depthFormat = static_cast<DepthFormat>((static_cast<int>(m_RenderInfo.depthFormat) + 1) % static_cast<int>(DepthFormat::SIZE));
+
+	SetConsoleTextAttribute(m_hConsole, 13);
+	switch (m_RenderInfo.depthFormat)
+	{
+	case dae::DepthFormat::D16:
+		std::cout << "[DEPTH FORMAT] 16-bit unorm\n";
+		break;
+	case dae::DepthFormat::D24:
+		std::cout << "[DEPTH FORMAT] 24-bit unorm\n";
+		break;
+	case dae::DepthFormat::D32:
+		std::cout << "[DEPTH FORMAT] 32-bit float\n";
+		break;
+	default:
+		break;
+	}
+}
+
 void dae::Scene::CycleFilteringMode()
 {
 	if (m_RenderInfo.renderType != RenderType::Hardware) return;
@@ -198,6 +372,38 @@ void dae::Scene::CycleFilteringMode()
 	}
 }
 
+void dae::Scene::CycleAddressMode()
+{
+	m_RenderInfo.textureAddressMode = static_cast<AddressMode>((static_cast<int>(m_RenderInfo.textureAddressMode) + 1) % static_cast<int>(AddressMode::SIZE));
+
+	SetConsoleTextAttribute(m_hConsole, 13);
+	switch (m_RenderInfo.textureAddressMode)
+	{
+	case dae::AddressMode::Wrap:
+		std::cout << "[TEXTURE ADDRESS MODE] Wrap\n";
+		break;
+	case dae::AddressMode::Mirror:
+		std::cout << "[TEXTURE ADDRESS MODE] Mirror\n";
+		break;
+	case dae::AddressMode::Clamp:
+		std::cout << "[TEXTURE ADDRESS MODE] Clamp\n";
+		break;
+	default:
+		break;
+	}
+}
+
+void dae::Scene::ToggleReverseZ()
+{
+	m_RenderInfo.useReverseZ = !m_RenderInfo.useReverseZ;
+	m_Camera.isReverseZ = m_RenderInfo.useReverseZ;
+	m_Camera.CalculateProjectionMatrix();
+
+	SetConsoleTextAttribute(m_hConsole, 13);
+	std::cout << "[REVERSE-Z] ";
+	m_RenderInfo.useReverseZ ? std::cout << "ON\n" : std::cout << "OFF\n";
+}
+
 void dae::Scene::CycleRenderMode()
 {
 	if (m_RenderInfo.renderType != RenderType::Software) return;
@@ -239,7 +445,9 @@ void dae::ReferenceScene::Initialize(ID3D11Device* pDevice)
 
 	SetConsoleTextAttribute(m_hConsole, 13);
 	std::cout
-		<< "  [F3] (EXTRA: SOFTWARE) Toggle FireFX (ON/OFF)\n";
+		<< "  [F3] (EXTRA: SOFTWARE) Toggle FireFX (ON/OFF)\n"
+		<< "  [U] (EXTRA) Cycle Texture Address Mode (WRAP/MIRROR/CLAMP)\n"
+		<< "  [K] (EXTRA) Toggle Reverse-Z Depth (ON/OFF)\n";
 
 	SetConsoleTextAttribute(m_hConsole, 6);
 	std::cout
@@ -264,50 +472,84 @@ void dae::ReferenceScene::Initialize(ID3D11Device* pDevice)
 	SetConsoleTextAttribute(m_hConsole, 13);
 	std::cout
 		<< "  [C] (EXTRA) Toggle Triangle Clipping (ON/OFF)\n"
-		<< "  [X] (EXTRA) Toggle MultiThreading (Vehicle only, disabled for FireFX due to artifacts) (ON/OFF)\n"
+		<< "  [X] (EXTRA) Toggle MultiThreading (ON/OFF)\n"
+		<< "  [F] (EXTRA) Toggle Fast Shading (approximated pow/rsqrt) (ON/OFF)\n"
+		<< "  [P] (EXTRA) Cycle Render Pipeline (FORWARD/DEFERRED/VISIBILITY_BUFFER)\n"
+		<< "  [O] (EXTRA) Toggle Depth Prepass (ON/OFF)\n"
+		<< "  [T] (EXTRA) Cycle Transparency Mode (ORDERED/WEIGHTED_BLENDED/SORTED_TILES)\n"
+		<< "  [M] (EXTRA) Toggle 4x MSAA (Forward pipeline only) (ON/OFF)\n"
+		<< "  [V] (EXTRA) Cycle Variable Rate Shading (OFF/LUMINANCE_GRADIENT/DISTANCE/RATE_IMAGE) (Forward pipeline only)\n"
+		<< "  [R] (EXTRA) Toggle Dynamic Resolution (33 ms frame budget) (ON/OFF)\n"
+		<< "  [L] (EXTRA) Toggle Frame Pipelining (one frame of latency) (ON/OFF)\n"
+		<< "  [N] (EXTRA) Cycle Depth Format (D16/D24/D32)\n"
 		<< std::endl;
 
+#if defined(DEBUG) || defined(_DEBUG)
+	// Sanity check of the fast shading approximations against the standard library, asserts when they are off
+	const FastMath::AccuracyReport accuracy{ FastMath::CheckAccuracy() };
+	SetConsoleTextAttribute(m_hConsole, 8);
+	std::cout << "[FAST SHADING] Max pow relative error: " << accuracy.maxPowError << " (< " << FastMath::MaxPowError << ")"
+		<< ", max rsqrt relative error: " << accuracy.maxRsqrtError << " (< " << FastMath::MaxRsqrtError << ")\n\n";
+#endif
+
 
 	m_Camera.Initialize(45.f, { 0.f, 0.f, 0.f });
 
-	std::vector<Vertex_In> vertices{};
-	std::vector<uint32_t> indices{};
+	// Parse both meshes on the job system while the textures get queued
+	std::vector<Vertex_In> vehicleVertices{}, fireVertices{};
+	std::vector<uint32_t> vehicleIndices{}, fireIndices{};
+	auto vehicleParsed{ m_pJobSystem->SubmitTask([&]() { return Utils::ParseOBJ("Resources/vehicle.obj", vehicleVertices, vehicleIndices); }) };
+	auto fireParsed{ m_pJobSystem->SubmitTask([&]() { return Utils::ParseOBJ("Resources/fireFX.obj", fireVertices, fireIndices); }) };
+
+	// Textures decode in the background, the placeholders are used until they are done
+	const Vector4 gray{ .5f, .5f, .5f, 1.f };
+	const Vector4 flatNormal{ .5f, .5f, 1.f, 1.f };
+	const Vector4 black{ 0.f, 0.f, 0.f, 1.f };
+	const Vector4 transparent{ 0.f, 0.f, 0.f, 0.f };
 
 	// Vehicle Textures
-	m_pVehicleDiffuse	= std::make_shared<Texture>(pDevice, "Resources/vehicle_diffuse.png");
-	m_pVehicleNormal	= std::make_shared<Texture>(pDevice, "Resources/vehicle_normal.png");
-	m_pVehicleSpecular	= std::make_shared<Texture>(pDevice, "Resources/vehicle_specular.png");
-	m_pVehicleGloss		= std::make_shared<Texture>(pDevice, "Resources/vehicle_gloss.png");
+	if (m_RenderInfo.useVirtualTexturing)
+	{
+		// Streamed page by page from tiled files, only what the software rasterizer samples stays resident
+		m_pVehicleDiffuse	= m_TextureManager.LoadVirtual(pDevice, "Resources/vehicle_diffuse.png", m_VirtualPageBudget);
+		m_pVehicleNormal	= m_TextureManager.LoadVirtual(pDevice, "Resources/vehicle_normal.png", m_VirtualPageBudget);
+		m_pVehicleSpecular	= m_TextureManager.LoadVirtual(pDevice, "Resources/vehicle_specular.png", m_VirtualPageBudget);
+		m_pVehicleGloss		= m_TextureManager.LoadVirtual(pDevice, "Resources/vehicle_gloss.png", m_VirtualPageBudget);
+	}
+	else
+	{
+		m_pVehicleDiffuse	= m_TextureManager.LoadAsync(pDevice, "Resources/vehicle_diffuse.png", gray);
+		m_pVehicleNormal	= m_TextureManager.LoadAsync(pDevice, "Resources/vehicle_normal.png", flatNormal);
+		m_pVehicleSpecular	= m_TextureManager.LoadAsync(pDevice, "Resources/vehicle_specular.png", black);
+		m_pVehicleGloss		= m_TextureManager.LoadAsync(pDevice, "Resources/vehicle_gloss.png", black);
+	}
 
 	// FireFX Textures
-	m_pFireDiffuse		= std::make_shared<Texture>(pDevice, "Resources/fireFX_diffuse.png");
+	m_pFireDiffuse		= m_TextureManager.LoadAsync(pDevice, "Resources/fireFX_diffuse.png", transparent);
 
 	// Vehicle Mesh
-	Utils::ParseOBJ("Resources/vehicle.obj", vertices, indices);	
-	m_pVehicleMesh = std::make_unique<Mesh>(pDevice, vertices, indices);
+	vehicleParsed.wait();
+	m_pVehicleMesh = std::make_unique<Mesh>(pDevice, vehicleVertices, vehicleIndices);
 	m_pVehicleMesh->SetDiffuseMap(m_pVehicleDiffuse);
 	m_pVehicleMesh->SetNormalMap(m_pVehicleNormal);
 	m_pVehicleMesh->SetSpecularMap(m_pVehicleSpecular);
 	m_pVehicleMesh->SetGlossMap(m_pVehicleGloss);
 
 	// FireFX Mesh
-	Utils::ParseOBJ("Resources/fireFX.obj", vertices, indices);
-	m_pFireMesh = std::make_unique<Mesh>(pDevice, vertices, indices);
+	fireParsed.wait();
+	m_pFireMesh = std::make_unique<Mesh>(pDevice, fireVertices, fireIndices);
 	m_pFireMesh->SetDiffuseMap(m_pFireDiffuse);
 
 	// Vehicle Effect
 	m_pVehicleEffect = std::make_shared<EffectPosTex>(pDevice, L"Resources/PosTex3D.fx");
-	m_pVehicleEffect->SetDiffuseMap(m_pVehicleDiffuse.get());
-	m_pVehicleEffect->SetNormalMap(m_pVehicleNormal.get());
-	m_pVehicleEffect->SetSpecularMap(m_pVehicleSpecular.get());
-	m_pVehicleEffect->SetGlossMap(m_pVehicleGloss.get());
 	m_pVehicleMesh->SetEffect(m_pVehicleEffect);
 
 	// FireFX Effect
 	m_pFireEffect = std::make_shared<EffectTransparent>(pDevice, L"Resources/PosTexTransparent3D.fx");
-	m_pFireEffect->SetDiffuseMap(m_pFireDiffuse.get());
 	m_pFireMesh->SetEffect(m_pFireEffect);
 
+	UpdateEffectTextures();
+
 	// Move the meshes back to fit inside the viewport
 	m_pVehicleMesh->Translate({ 0.f, 0.f, 50.f });
 	m_pFireMesh->Translate({ 0.f, 0.f, 50.f });
@@ -345,6 +587,8 @@ void dae::ReferenceScene::Update(const Timer* pTimer, ID3D11Device* pDevice)
 	std::for_each(begin(m_pEffects), end(m_pEffects), [&](std::shared_ptr<Effect>& effect)
 		{
 			effect->SetTextureFiltering(m_RenderInfo.textureFiltering);
+			effect->SetTextureAddressMode(m_RenderInfo.textureAddressMode);
+			effect->SetReverseZ(m_RenderInfo.useReverseZ);
 		}
 	);
 
@@ -355,4 +599,37 @@ void dae::ReferenceScene::Update(const Timer* pTimer, ID3D11Device* pDevice)
 			mesh->Update(m_Camera.viewMatrix, m_Camera.projectionMatrix);
 		}
 	);
+}
+
+void dae::ReferenceScene::UpdateResources(ID3D11Device* pDevice)
+{
+	Scene::UpdateResources(pDevice);
+
+	// Stream in the virtual texture pages the last frame asked for
+	m_TextureManager.UpdateVirtualTextures(m_FrameIndex++);
+
+	// Swap in the textures that finished decoding, their SRVs changed so the effects need to be rebound
+	if (m_TextureManager.FinalizeLoads(pDevice) > 0)
+	{
+		m_EffectUpdateRequired = true;
+
+		SetConsoleTextAttribute(m_hConsole, 8);
+		std::cout << "[TEXTURES] Loaded " << m_TextureManager.GetNumLoadsCompleted() << '/' << m_TextureManager.GetNumLoadsRequested() << '\n';
+	}
+
+	if (m_EffectUpdateRequired)
+	{
+		UpdateEffectTextures();
+		m_EffectUpdateRequired = false;
+	}
+}
+
+void dae::ReferenceScene::UpdateEffectTextures()
+{
+	m_pVehicleEffect->SetDiffuseMap(m_pVehicleDiffuse.get());
+	m_pVehicleEffect->SetNormalMap(m_pVehicleNormal.get());
+	m_pVehicleEffect->SetSpecularMap(m_pVehicleSpecular.get());
+	m_pVehicleEffect->SetGlossMap(m_pVehicleGloss.get());
+
+	m_pFireEffect->SetDiffuseMap(m_pFireDiffuse.get());
 }
\ No newline at end of file
@@ -1,12 +1,15 @@
 #pragma once
 #include "Camera.h"
+#include "TextureManager.h"
+#include "JobSystem.h"
 
 namespace dae
 {
 	class Scene
 	{
 	public:
-		Scene() = default;
+		// The job system is shared with the renderer and has to outlive the scene
+		Scene(JobSystem* pJobSystem) : m_pJobSystem{ pJobSystem } {}
 		virtual ~Scene() = default;
 
 		Scene(const Scene& other) = delete;
@@ -21,10 +24,23 @@ namespace dae
 			m_Camera.Update(pTimer);
 		};
 
+		// Everything that changes textures, only called while no frame is in flight (Renderer::WaitForFrame)
+		virtual void UpdateResources(ID3D11Device* pDevice)
+		{
+			if (m_TextureManager.GetAddressMode() != m_RenderInfo.textureAddressMode)
+				m_TextureManager.SetAddressMode(m_RenderInfo.textureAddressMode);
+		};
+
 		// Getters
 		Camera GetCamera() const { return m_Camera; }
 		RenderInfo GetRenderInfo() const { return m_RenderInfo; }
 		std::vector<std::shared_ptr<Mesh>> GetMeshes() { return m_pMeshes; }
+		bool IsLoading() const { return m_TextureManager.IsLoading(); }
+
+		// For runs without keyboard input, like headless rendering
+		void SetRenderType(RenderType renderType) { m_RenderInfo.renderType = renderType; }
+		// Picks how the textures get loaded, so it only has an effect before Initialize
+		void SetUseVirtualTexturing(bool useVirtualTexturing) { m_RenderInfo.useVirtualTexturing = useVirtualTexturing; }
 
 	protected:
 		bool m_EffectUpdateRequired{ false };
@@ -38,12 +54,17 @@ namespace dae
 		std::vector<std::shared_ptr<Mesh>> m_pMeshes;
 		std::vector<std::shared_ptr<Effect>> m_pEffects;
 
+		JobSystem* m_pJobSystem;
+		TextureManager m_TextureManager{ m_pJobSystem };
+
 		HANDLE m_hConsole;
 
 		void CycleRenderType();
 		void ToggleRotation();
 		void ToggleFireFX();
 		void CycleFilteringMode();
+		void CycleAddressMode();
+		void ToggleReverseZ();
 		void CycleRenderMode();
 		void ToggleNormalMap();
 		void ToggleDepthBufferVisual();
@@ -53,12 +74,21 @@ namespace dae
 		void ToggleFPS();
 		void ToggleClipping();
 		void ToggleMultiThreading();
+		void ToggleFastShading();
+		void CycleRenderPipeline();
+		void ToggleDepthPrepass();
+		void CycleTransparencyMode();
+		void ToggleMSAA();
+		void CycleShadingRatePolicy();
+		void ToggleDynamicResolution();
+		void ToggleFramePipelining();
+		void CycleDepthFormat();
 	};
 
 	class ReferenceScene final : public Scene
 	{
 	public:
-		ReferenceScene() = default;
+		ReferenceScene(JobSystem* pJobSystem) : Scene(pJobSystem) {}
 		~ReferenceScene() = default;
 
 		ReferenceScene(const ReferenceScene& other) = delete;
@@ -68,9 +98,15 @@ namespace dae
 
 		void Initialize(ID3D11Device* pDevice) override;
 		void Update(const Timer* pTimer, ID3D11Device* pDevice) override;
+		void UpdateResources(ID3D11Device* pDevice) override;
 
 
 	private:
+		void UpdateEffectTextures();
+
+		const uint32_t m_VirtualPageBudget{ 32 };
+		uint64_t m_FrameIndex{ 0 };
+
 		// Vehicle
 		std::shared_ptr<Mesh> m_pVehicleMesh;
 
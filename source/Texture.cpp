@@ -2,13 +2,38 @@
 #include "Texture.h"
 #include "Vector2.h"
 #include "Vector3.h"
+#include "VirtualTexture.h"
 #include <SDL_image.h>
 
 namespace dae
 {
 	Texture::Texture(ID3D11Device* pDevice, const std::string& path)
+		: Texture(pDevice, LoadFromFile(path))
 	{
-		m_pSurface = LoadFromFile(path);
+	}
+
+	Texture::Texture(ID3D11Device* pDevice, SDL_Surface* pSurface)
+	{
+		SetSurface(pDevice, pSurface);
+	}
+
+	Texture::Texture(ID3D11Device* pDevice, std::unique_ptr<VirtualTexture> pVirtualTexture)
+		: m_pVirtualTexture(std::move(pVirtualTexture))
+	{
+		SetSurface(pDevice, m_pVirtualTexture->CreateCoarsestMipSurface());
+		SelectFetchTexel();
+	}
+
+	Texture::~Texture()
+	{
+		ReleaseResources();
+	}
+
+	void Texture::SetSurface(ID3D11Device* pDevice, SDL_Surface* pSurface)
+	{
+		ReleaseResources();
+
+		m_pSurface = pSurface;
 		m_pSurfacePixels = (uint32_t*)m_pSurface->pixels;
 		
 		// Load Texture
@@ -44,66 +69,186 @@ namespace dae
 		hr = pDevice->CreateShaderResourceView(m_pResource, &SRV_desc, &m_pSRV);
 		if (!SUCCEEDED(hr))
 			assert(-1);
+
+		// The size might have changed whether the power-of-two path applies
+		SelectFetchTexel();
 	}
 
-	Texture::~Texture()
+	void Texture::ReleaseResources()
 	{
-		m_pSRV->Release();
-		m_pResource->Release();
+		if (m_pSRV)
+		{
+			m_pSRV->Release();
+			m_pSRV = nullptr;
+		}
+
+		if (m_pResource)
+		{
+			m_pResource->Release();
+			m_pResource = nullptr;
+		}
 
 		if (m_pSurface)
 		{
 			SDL_FreeSurface(m_pSurface);
 			m_pSurface = nullptr;
+			m_pSurfacePixels = nullptr;
 		}
 	}
 
-	ColorRGB Texture::SampleColor(const Vector2& uv) const
+	ColorRGB Texture::SampleColor(const Vector2& uv, float uvLod) const
 	{
-		const Uint32 px{ static_cast<Uint32>(std::clamp(uv.x, 0.f, 1.f) * m_pSurface->w) };
-		const Uint32 py{ static_cast<Uint32>(std::clamp(uv.y, 0.f, 1.f) * m_pSurface->h) };
-		const Uint32 pixelIndex{ static_cast<Uint32>(px + (py * m_pSurface->w)) };
-
 		Uint8 r, g, b;
-		SDL_GetRGB(m_pSurfacePixels[pixelIndex], m_pSurface->format, &r, &g, &b);
+		SDL_GetRGB((this->*m_pFetchTexel)(uv, uvLod), m_pSurface->format, &r, &g, &b);
 
 		const float invResize = 1 / 255.f;
 		return ColorRGB{ r * invResize , g * invResize, b * invResize };
 	}
 
-	Vector4 Texture::SampleRGBA(const Vector2& uv) const
+	Vector4 Texture::SampleRGBA(const Vector2& uv, float uvLod) const
 	{
-		const Uint32 px{ static_cast<Uint32>(std::clamp(uv.x, 0.f, 1.f) * m_pSurface->w) };
-		const Uint32 py{ static_cast<Uint32>(std::clamp(uv.y, 0.f, 1.f) * m_pSurface->h) };
-		const Uint32 pixelIndex{ static_cast<Uint32>(px + (py * m_pSurface->w)) };
-
 		Uint8 r, g, b, a;
-		SDL_GetRGBA(m_pSurfacePixels[pixelIndex], m_pSurface->format, &r, &g, &b, &a);
+		SDL_GetRGBA((this->*m_pFetchTexel)(uv, uvLod), m_pSurface->format, &r, &g, &b, &a);
 
 		const float invResize = 1 / 255.f;
 		return Vector4{ r * invResize , g * invResize, b * invResize, a * invResize };
 	}
 
-	Vector3 Texture::SampleNormal(const Vector2& uv) const
+	Vector3 Texture::SampleNormal(const Vector2& uv, float uvLod) const
 	{
-		const Uint32 px{ static_cast<Uint32>(std::clamp(uv.x, 0.f, 1.f) * m_pSurface->w) };
-		const Uint32 py{ static_cast<Uint32>(std::clamp(uv.y, 0.f, 1.f) * m_pSurface->h) };
-		const Uint32 pixelIndex{ static_cast<Uint32>(px + (py * m_pSurface->w)) };
-
 		Uint8 r, g, b;
-		SDL_GetRGB(m_pSurfacePixels[pixelIndex], m_pSurface->format, &r, &g, &b);
+		SDL_GetRGB((this->*m_pFetchTexel)(uv, uvLod), m_pSurface->format, &r, &g, &b);
 
 		const float invResize = 1 / 255.f;
 		return Vector3{ r * invResize , g * invResize, b * invResize };
 	}
 
+	void Texture::SetAddressMode(AddressMode mode)
+	{
+		m_AddressMode = mode;
+		SelectFetchTexel();
+	}
+
+	void Texture::SelectFetchTexel()
+	{
+		if (m_pVirtualTexture)
+		{
+			switch (m_AddressMode)
+			{
+			case AddressMode::Wrap:		m_pFetchTexel = &Texture::FetchVirtualTexel<AddressMode::Wrap>; break;
+			case AddressMode::Mirror:	m_pFetchTexel = &Texture::FetchVirtualTexel<AddressMode::Mirror>; break;
+			case AddressMode::Clamp:	m_pFetchTexel = &Texture::FetchVirtualTexel<AddressMode::Clamp>; break;
+			}
+			return;
+		}
+
+		// Power-of-two textures wrap and mirror with bitmasks instead of modulos
+		const bool isPowerOfTwo{ (m_pSurface->w & (m_pSurface->w - 1)) == 0 && (m_pSurface->h & (m_pSurface->h - 1)) == 0 };
+		switch (m_AddressMode)
+		{
+		case AddressMode::Wrap:
+			m_pFetchTexel = isPowerOfTwo ? &Texture::FetchTexel<AddressMode::Wrap, true> : &Texture::FetchTexel<AddressMode::Wrap, false>;
+			break;
+		case AddressMode::Mirror:
+			m_pFetchTexel = isPowerOfTwo ? &Texture::FetchTexel<AddressMode::Mirror, true> : &Texture::FetchTexel<AddressMode::Mirror, false>;
+			break;
+		case AddressMode::Clamp:
+			m_pFetchTexel = &Texture::FetchTexel<AddressMode::Clamp, false>;
+			break;
+		}
+	}
+
+	template<AddressMode mode, bool isPowerOfTwo>
+	Uint32 Texture::FetchTexel(const Vector2& uv, float) const
+	{
+		const int px{ AddressTexel<mode, isPowerOfTwo>(FloorToInt(uv.x * m_pSurface->w), m_pSurface->w) };
+		const int py{ AddressTexel<mode, isPowerOfTwo>(FloorToInt(uv.y * m_pSurface->h), m_pSurface->h) };
+		return m_pSurfacePixels[px + (py * m_pSurface->w)];
+	}
+
+	template<AddressMode mode>
+	Uint32 Texture::FetchVirtualTexel(const Vector2& uv, float uvLod) const
+	{
+		// Address in a fixed-point uv space, the virtual texture picks the mip and clamps inside of it
+		constexpr int precision{ 1 << 16 };
+		const Vector2 addressedUV
+		{
+			static_cast<float>(AddressTexel<mode, true>(FloorToInt(uv.x * precision), precision)) / precision,
+			static_cast<float>(AddressTexel<mode, true>(FloorToInt(uv.y * precision), precision)) / precision
+		};
+
+		// Pages are stored in the same R8G8B8A8 layout as the coarsest mip surface, so it decodes with the same format
+		return m_pVirtualTexture->Sample(addressedUV, uvLod);
+	}
+
+	template<AddressMode mode, bool isPowerOfTwo>
+	int Texture::AddressTexel(int texel, int size)
+	{
+		if constexpr (mode == AddressMode::Wrap)
+		{
+			if constexpr (isPowerOfTwo)
+				return texel & (size - 1);
+			else
+				return ((texel % size) + size) % size;
+		}
+		else if constexpr (mode == AddressMode::Mirror)
+		{
+			if constexpr (isPowerOfTwo)
+			{
+				// Every odd period runs backwards: flip the bits of the offset
+				const int flip{ -((texel & size) != 0) };
+				return (texel & (size - 1)) ^ (flip & (size - 1));
+			}
+			else
+			{
+				const int period{ ((texel % (2 * size)) + 2 * size) % (2 * size) };
+				return std::min(period, 2 * size - 1 - period);
+			}
+		}
+		else
+		{
+			return std::clamp(texel, 0, size - 1);
+		}
+	}
+
 	ID3D11ShaderResourceView* Texture::GetSRV() const
 	{
 		return m_pSRV;
 	}
 
+	int Texture::GetWidth() const
+	{
+		return m_pVirtualTexture ? static_cast<int>(m_pVirtualTexture->GetWidth()) : m_pSurface->w;
+	}
+
+	int Texture::GetHeight() const
+	{
+		return m_pVirtualTexture ? static_cast<int>(m_pVirtualTexture->GetHeight()) : m_pSurface->h;
+	}
+
+	size_t Texture::GetMemorySize() const
+	{
+		// CPU copy for the software rasterizer + GPU copy for the hardware rasterizer
+		const size_t cpuSize{ static_cast<size_t>(m_pSurface->pitch) * m_pSurface->h };
+		const size_t gpuSize{ static_cast<size_t>(m_pSurface->w) * m_pSurface->h * 4 };
+		const size_t virtualSize{ m_pVirtualTexture ? m_pVirtualTexture->GetMemorySize() : 0 };
+		return cpuSize + gpuSize + virtualSize;
+	}
+
 	SDL_Surface* Texture::LoadFromFile(const std::string& path)
 	{
 		return IMG_Load(path.c_str());
 	}
+
+	SDL_Surface* Texture::CreateSolidSurface(const Vector4& color)
+	{
+		// R8G8B8A8 in memory, same layout the GPU texture is created with
+		SDL_Surface* pSurface{ SDL_CreateRGBSurfaceWithFormat(0, 1, 1, 32, SDL_PIXELFORMAT_ABGR8888) };
+		*static_cast<uint32_t*>(pSurface->pixels) = SDL_MapRGBA(pSurface->format,
+			static_cast<uint8_t>(color.x * 255),
+			static_cast<uint8_t>(color.y * 255),
+			static_cast<uint8_t>(color.z * 255),
+			static_cast<uint8_t>(color.w * 255));
+		return pSurface;
+	}
 }
\ No newline at end of file
@@ -3,24 +3,68 @@
 
 namespace dae
 {
+	class VirtualTexture;
+
 	class Texture final
 	{
 	public:
 		Texture(ID3D11Device* pDevice, const std::string& path);
+		Texture(ID3D11Device* pDevice, SDL_Surface* pSurface);
+		// Streams its texels from a tiled file, the GPU copy only holds the coarsest mip
+		Texture(ID3D11Device* pDevice, std::unique_ptr<VirtualTexture> pVirtualTexture);
 		~Texture();
 
-		ColorRGB SampleColor(const Vector2& uv) const;
-		Vector4 SampleRGBA(const Vector2& uv) const;
-		Vector3 SampleNormal(const Vector2& uv) const;
+		Texture(const Texture&) = delete;
+		Texture(Texture&&) noexcept = delete;
+		Texture& operator=(const Texture&) = delete;
+		Texture& operator=(Texture&&) noexcept = delete;
+
+		// uvLod is the log2 of the uv extent covered by one pixel, only virtual textures pick a mip with it
+		ColorRGB SampleColor(const Vector2& uv, float uvLod) const;
+		Vector4 SampleRGBA(const Vector2& uv, float uvLod) const;
+		Vector3 SampleNormal(const Vector2& uv, float uvLod) const;
+
+		// Picks the texel fetch specialization once, so sampling itself never branches on the mode
+		void SetAddressMode(AddressMode mode);
+		AddressMode GetAddressMode() const { return m_AddressMode; }
 
 		ID3D11ShaderResourceView* GetSRV() const;
+
+		int GetWidth() const;
+		int GetHeight() const;
+		size_t GetMemorySize() const;
+
+		VirtualTexture* GetVirtualTexture() const { return m_pVirtualTexture.get(); }
+
+		// Replaces the texel data (and GPU resources), takes ownership of the surface
+		void SetSurface(ID3D11Device* pDevice, SDL_Surface* pSurface);
+
+		static SDL_Surface* LoadFromFile(const std::string& path);
+		static SDL_Surface* CreateSolidSurface(const Vector4& color);
+
 	private:
-		SDL_Surface* LoadFromFile(const std::string& path);
+		using FetchTexelFunc = Uint32 (Texture::*)(const Vector2& uv, float uvLod) const;
+
+		void ReleaseResources();
+		void SelectFetchTexel();
+
+		template<AddressMode mode, bool isPowerOfTwo>
+		Uint32 FetchTexel(const Vector2& uv, float uvLod) const;
+		template<AddressMode mode>
+		Uint32 FetchVirtualTexel(const Vector2& uv, float uvLod) const;
 
-		ID3D11Texture2D* m_pResource;
-		ID3D11ShaderResourceView* m_pSRV;
+		template<AddressMode mode, bool isPowerOfTwo>
+		static int AddressTexel(int texel, int size);
+
+		ID3D11Texture2D* m_pResource{ nullptr };
+		ID3D11ShaderResourceView* m_pSRV{ nullptr };
 
 		SDL_Surface* m_pSurface{ nullptr };
 		uint32_t* m_pSurfacePixels{ nullptr };
+
+		std::unique_ptr<VirtualTexture> m_pVirtualTexture{};
+
+		AddressMode m_AddressMode{ AddressMode::Wrap };
+		FetchTexelFunc m_pFetchTexel{ nullptr };
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,303 @@
+#include "pch.h"
+#include "TextureManager.h"
+#include "JobSystem.h"
+#include "VirtualTexture.h"
+#include <filesystem>
+#include <fstream>
+
+namespace dae
+{
+	TextureManager::TextureManager(JobSystem* pJobSystem)
+		: m_pJobSystem(pJobSystem)
+	{
+	}
+
+	TextureManager::~TextureManager()
+	{
+		// Don't leak the surfaces of loads that never got finalized
+		for (auto& pendingLoad : m_PendingLoads)
+		{
+			if (SDL_Surface* pSurface{ pendingLoad.surface.get() })
+				SDL_FreeSurface(pSurface);
+		}
+	}
+
+	std::shared_ptr<Texture> TextureManager::Load(ID3D11Device* pDevice, const std::string& path)
+	{
+		const std::string canonicalPath{ GetCanonicalPath(path) };
+
+		// Same file requested again, skip reading it from disk
+		if (auto pTexture{ FindLoaded(canonicalPath) })
+			return pTexture;
+
+		std::vector<char> contents{};
+		if (!ReadContents(canonicalPath, contents))
+		{
+			std::cout << "TextureManager: Failed to open '" << path << "'\n";
+			return nullptr;
+		}
+
+		// Different path but identical contents, share the already decoded texture
+		const uint64_t key{ FindAssetKey(contents) };
+		m_PathToKey[canonicalPath] = key;
+
+		if (auto pTexture{ FindLoaded(canonicalPath) })
+			return pTexture;
+
+		// Decode straight from the bytes we already read for hashing
+		SDL_Surface* pSurface{ DecodeContents(contents) };
+		if (!pSurface)
+		{
+			std::cout << "TextureManager: Failed to decode '" << path << "': " << IMG_GetError() << '\n';
+			m_PathToKey.erase(canonicalPath);
+			return nullptr;
+		}
+
+		const auto pTexture{ std::make_shared<Texture>(pDevice, pSurface) };
+		AddAsset(key, canonicalPath, pTexture);
+		return pTexture;
+	}
+
+	std::shared_ptr<Texture> TextureManager::LoadAsync(ID3D11Device* pDevice, const std::string& path, const Vector4& placeholderColor)
+	{
+		if (!m_pJobSystem)
+			return Load(pDevice, path);
+
+		const std::string canonicalPath{ GetCanonicalPath(path) };
+		if (auto pTexture{ FindLoaded(canonicalPath) })
+			return pTexture;
+
+		// Reading + hashing is cheap compared to decoding, doing it here keeps the deduplication synchronous
+		std::vector<char> contents{};
+		if (!ReadContents(canonicalPath, contents))
+		{
+			std::cout << "TextureManager: Failed to open '" << path << "'\n";
+			return nullptr;
+		}
+
+		const uint64_t key{ FindAssetKey(contents) };
+		m_PathToKey[canonicalPath] = key;
+
+		if (auto pTexture{ FindLoaded(canonicalPath) })
+			return pTexture;
+
+		const auto pTexture{ std::make_shared<Texture>(pDevice, Texture::CreateSolidSurface(placeholderColor)) };
+		AddAsset(key, canonicalPath, pTexture);
+
+		m_PendingLoads.push_back(PendingLoad{ key, path,
+			m_pJobSystem->SubmitTask([contents = std::move(contents)]() { return DecodeContents(contents); }) });
+		++m_NumLoadsRequested;
+
+		return pTexture;
+	}
+
+	std::shared_ptr<Texture> TextureManager::LoadVirtual(ID3D11Device* pDevice, const std::string& path, uint32_t residentPageBudget)
+	{
+		const std::string canonicalPath{ GetCanonicalPath(path) };
+		const std::string tiledPath{ std::filesystem::path{ canonicalPath }.replace_extension(".vtex").string() };
+
+		// Keyed on the tiled file, hashing the contents would mean reading the whole texture which is what we try to avoid
+		if (auto pTexture{ FindLoaded(tiledPath) })
+			return pTexture;
+
+		std::error_code error{};
+		const bool isTiledUpToDate{ std::filesystem::exists(tiledPath, error) &&
+			std::filesystem::last_write_time(tiledPath, error) >= std::filesystem::last_write_time(canonicalPath, error) };
+
+		if (!isTiledUpToDate)
+		{
+			SDL_Surface* pSurface{ Texture::LoadFromFile(canonicalPath) };
+			const bool isWritten{ VirtualTexture::WriteTiledFile(pSurface, tiledPath) };
+			if (pSurface)
+				SDL_FreeSurface(pSurface);
+
+			if (!isWritten)
+			{
+				std::cout << "TextureManager: Failed to write tiled texture for '" << path << "', loading it regularly\n";
+				return Load(pDevice, path);
+			}
+		}
+
+		auto pVirtualTexture{ std::make_unique<VirtualTexture>(tiledPath, residentPageBudget) };
+		if (!pVirtualTexture->IsValid())
+			return Load(pDevice, path);
+
+		// The path hash can land on a taken key too, it moves on to the next free one like a content hash collision
+		uint64_t key{ std::hash<std::string>{}(tiledPath) };
+		while (m_Assets.contains(key))
+			++key;
+		m_PathToKey[tiledPath] = key;
+
+		const auto pTexture{ std::make_shared<Texture>(pDevice, std::move(pVirtualTexture)) };
+		AddAsset(key, tiledPath, pTexture);
+		return pTexture;
+	}
+
+	void TextureManager::UpdateVirtualTextures(uint64_t frameIndex)
+	{
+		for (auto& asset : m_Assets)
+		{
+			if (VirtualTexture* pVirtualTexture{ asset.second.pTexture->GetVirtualTexture() })
+				pVirtualTexture->Update(frameIndex);
+		}
+	}
+
+	uint32_t TextureManager::FinalizeLoads(ID3D11Device* pDevice)
+	{
+		uint32_t numFinalized{ 0 };
+		for (auto it = m_PendingLoads.begin(); it != m_PendingLoads.end();)
+		{
+			if (it->surface.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			{
+				++it;
+				continue;
+			}
+
+			SDL_Surface* pSurface{ it->surface.get() };
+			const auto assetIt{ m_Assets.find(it->key) };
+
+			if (!pSurface)
+			{
+				// Keep the placeholder, it is still a valid texture to render with
+				std::cout << "TextureManager: Failed to decode '" << it->path << "'\n";
+			}
+			else if (assetIt == m_Assets.end())
+			{
+				// Evicted while decoding
+				SDL_FreeSurface(pSurface);
+			}
+			else
+			{
+				Asset& asset{ assetIt->second };
+				asset.pTexture->SetSurface(pDevice, pSurface);
+
+				m_MemoryUsage -= asset.memorySize;
+				asset.memorySize = asset.pTexture->GetMemorySize();
+				m_MemoryUsage += asset.memorySize;
+				++numFinalized;
+			}
+
+			it = m_PendingLoads.erase(it);
+		}
+
+		if (numFinalized > 0 && m_MemoryBudget > 0 && m_MemoryUsage > m_MemoryBudget)
+			EvictUnused();
+
+		return numFinalized;
+	}
+
+	size_t TextureManager::EvictUnused()
+	{
+		size_t freedMemory{ 0 };
+		for (auto it = m_Assets.begin(); it != m_Assets.end();)
+		{
+			// The manager holds the only reference left
+			if (it->second.pTexture.use_count() == 1)
+			{
+				freedMemory += it->second.memorySize;
+				it = m_Assets.erase(it);
+			}
+			else
+				++it;
+		}
+
+		// Drop the path entries pointing to evicted textures
+		std::erase_if(m_PathToKey, [&](const auto& entry) { return !m_Assets.contains(entry.second); });
+
+		m_MemoryUsage -= freedMemory;
+		return freedMemory;
+	}
+
+	size_t TextureManager::GetMemoryUsage(const std::string& path) const
+	{
+		const auto pathIt{ m_PathToKey.find(GetCanonicalPath(path)) };
+		if (pathIt == m_PathToKey.end())
+			return 0;
+
+		const auto assetIt{ m_Assets.find(pathIt->second) };
+		return assetIt != m_Assets.end() ? assetIt->second.memorySize : 0;
+	}
+
+	std::shared_ptr<Texture> TextureManager::FindLoaded(const std::string& canonicalPath) const
+	{
+		const auto pathIt{ m_PathToKey.find(canonicalPath) };
+		if (pathIt == m_PathToKey.end())
+			return nullptr;
+
+		const auto assetIt{ m_Assets.find(pathIt->second) };
+		return assetIt != m_Assets.end() ? assetIt->second.pTexture : nullptr;
+	}
+
+	bool TextureManager::ReadContents(const std::string& canonicalPath, std::vector<char>& contents) const
+	{
+		std::ifstream file{ canonicalPath, std::ios::binary | std::ios::ate };
+		if (!file)
+			return false;
+
+		contents.resize(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(contents.data(), contents.size());
+		return true;
+	}
+
+	void TextureManager::SetAddressMode(AddressMode mode)
+	{
+		m_AddressMode = mode;
+		for (auto& [key, asset] : m_Assets)
+			asset.pTexture->SetAddressMode(mode);
+	}
+
+	uint64_t TextureManager::FindAssetKey(const std::vector<char>& contents) const
+	{
+		// Walk the keys from the hash on until an asset with the exact same bytes or a free key shows up
+		uint64_t key{ HashContents(contents) };
+		for (auto assetIt{ m_Assets.find(key) }; assetIt != m_Assets.end(); assetIt = m_Assets.find(++key))
+		{
+			std::error_code error{};
+			const std::string& assetPath{ assetIt->second.path };
+			const auto fileSize{ std::filesystem::file_size(assetPath, error) };
+			if (error || fileSize != contents.size())
+				continue;
+
+			std::vector<char> assetContents{};
+			if (ReadContents(assetPath, assetContents) && assetContents == contents)
+				return key;
+		}
+		return key;
+	}
+
+	void TextureManager::AddAsset(uint64_t key, const std::string& canonicalPath, const std::shared_ptr<Texture>& pTexture)
+	{
+		pTexture->SetAddressMode(m_AddressMode);
+		Asset asset{ pTexture, pTexture->GetMemorySize(), canonicalPath };
+		m_MemoryUsage += asset.memorySize;
+		m_Assets.emplace(key, std::move(asset));
+
+		if (m_MemoryBudget > 0 && m_MemoryUsage > m_MemoryBudget)
+			EvictUnused();
+	}
+
+	std::string TextureManager::GetCanonicalPath(const std::string& path)
+	{
+		std::error_code error{};
+		const std::filesystem::path canonicalPath{ std::filesystem::weakly_canonical(path, error) };
+		return error ? path : canonicalPath.string();
+	}
+
+	uint64_t TextureManager::HashContents(const std::vector<char>& contents)
+	{
+		// 64-bit FNV-1a
+		uint64_t hash{ 14695981039346656037ULL };
+		for (const char byte : contents)
+		{
+			hash ^= static_cast<uint8_t>(byte);
+			hash *= 1099511628211ULL;
+		}
+		return hash;
+	}
+
+	SDL_Surface* TextureManager::DecodeContents(const std::vector<char>& contents)
+	{
+		return IMG_Load_RW(SDL_RWFromConstMem(contents.data(), static_cast<int>(contents.size())), 1);
+	}
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <future>
+#include <string>
+#include <unordered_map>
+
+namespace dae
+{
+	class Texture;
+	class JobSystem;
+
+	// Hands out shared texture handles so every asset is only decoded and uploaded once.
+	// Textures are deduplicated on their canonical path first and on the hash of their file contents second,
+	// so copies of the same image under different names also end up sharing one Texture.
+	// A hash match only gets shared once the bytes match too, colliding contents move on to the next free key.
+	class TextureManager final
+	{
+	public:
+		TextureManager(JobSystem* pJobSystem = nullptr);
+		~TextureManager();
+
+		TextureManager(const TextureManager&) = delete;
+		TextureManager(TextureManager&&) noexcept = delete;
+		TextureManager& operator=(const TextureManager&) = delete;
+		TextureManager& operator=(TextureManager&&) noexcept = delete;
+
+		std::shared_ptr<Texture> Load(ID3D11Device* pDevice, const std::string& path);
+
+		// Returns a texture filled with the placeholder color right away and decodes the file on the job system.
+		// The decoded texels are swapped in by FinalizeLoads, so the returned handle stays valid throughout.
+		std::shared_ptr<Texture> LoadAsync(ID3D11Device* pDevice, const std::string& path, const Vector4& placeholderColor);
+
+		// Streams the texture through a tiled file next to the source image (written on first use),
+		// only the pages the software rasterizer touches stay in memory, up to residentPageBudget pages
+		std::shared_ptr<Texture> LoadVirtual(ID3D11Device* pDevice, const std::string& path, uint32_t residentPageBudget);
+
+		// Feeds the sampling feedback of the last frame to all virtual textures, call once per frame from the main thread
+		void UpdateVirtualTextures(uint64_t frameIndex);
+
+		// Uploads every texture that finished decoding, call once per frame from the main thread.
+		// Returns how many textures got their final contents (their SRVs need to be rebound).
+		uint32_t FinalizeLoads(ID3D11Device* pDevice);
+
+		bool IsLoading() const { return !m_PendingLoads.empty(); }
+		uint32_t GetNumLoadsRequested() const { return m_NumLoadsRequested; }
+		uint32_t GetNumLoadsCompleted() const { return m_NumLoadsRequested - static_cast<uint32_t>(m_PendingLoads.size()); }
+
+		// Releases every texture that is no longer referenced outside of the manager, returns the freed bytes
+		size_t EvictUnused();
+
+		// Unused textures get evicted as soon as the total memory usage exceeds the budget (0 = unlimited)
+		void SetMemoryBudget(size_t bytes) { m_MemoryBudget = bytes; }
+
+		// Applied to every loaded texture and to the ones loaded afterwards
+		void SetAddressMode(AddressMode mode);
+		AddressMode GetAddressMode() const { return m_AddressMode; }
+
+		size_t GetMemoryUsage() const { return m_MemoryUsage; }
+		size_t GetMemoryUsage(const std::string& path) const;
+		size_t GetNumTextures() const { return m_Assets.size(); }
+
+	private:
+		struct Asset
+		{
+			std::shared_ptr<Texture> pTexture;
+			size_t memorySize;
+			std::string path; // Canonical path the contents came from, to compare against on a hash match
+		};
+
+		struct PendingLoad
+		{
+			uint64_t key;
+			std::string path;
+			std::future<SDL_Surface*> surface;
+		};
+
+		std::shared_ptr<Texture> FindLoaded(const std::string& canonicalPath) const;
+		bool ReadContents(const std::string& canonicalPath, std::vector<char>& contents) const;
+		uint64_t FindAssetKey(const std::vector<char>& contents) const;
+		void AddAsset(uint64_t key, const std::string& canonicalPath, const std::shared_ptr<Texture>& pTexture);
+
+		static std::string GetCanonicalPath(const std::string& path);
+		static uint64_t HashContents(const std::vector<char>& contents);
+		static SDL_Surface* DecodeContents(const std::vector<char>& contents);
+
+		JobSystem* m_pJobSystem;
+
+		std::unordered_map<std::string, uint64_t> m_PathToKey{};
+		std::unordered_map<uint64_t, Asset> m_Assets{};
+		std::vector<PendingLoad> m_PendingLoads{};
+		uint32_t m_NumLoadsRequested{ 0 };
+
+		size_t m_MemoryUsage{ 0 };
+		size_t m_MemoryBudget{ 0 };
+		AddressMode m_AddressMode{ AddressMode::Wrap };
+	};
+}
@@ -3,6 +3,7 @@
 #include <vector>
 #include "Math.h"
 #include "DataTypes.h"
+#include "FastMath.h"
 
 namespace dae
 {
@@ -37,6 +38,15 @@ namespace dae
 
 			return phong_specular;
 		}
+
+		inline float PhongSpecularFast(float ks, float exp, const Vector3& l, const Vector3& v, const Vector3& n)
+		{
+			const Vector3 reflect{ Vector3::Reflect(-l, n) };
+			const float cos_angle{ std::max(0.f, Vector3::Dot(reflect, v)) };
+			const float phong_specular{ ks * FastMath::Pow(cos_angle, exp) };
+
+			return phong_specular;
+		}
 	}
 
 	namespace Utils
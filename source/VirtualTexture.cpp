@@ -0,0 +1,248 @@
+#include "pch.h"
+#include "VirtualTexture.h"
+
+namespace dae
+{
+	VirtualTexture::VirtualTexture(const std::string& tiledPath, uint32_t residentPageBudget)
+		: m_File{ tiledPath, std::ios::binary }
+	{
+		Header header{};
+		if (!m_File.read(reinterpret_cast<char*>(&header), sizeof(Header)) || header.magic != m_Magic || header.version != m_Version)
+		{
+			std::cout << "VirtualTexture: '" << tiledPath << "' is not a valid tiled texture\n";
+			return;
+		}
+
+		m_Width = header.width;
+		m_Height = header.height;
+		m_PageSize = header.pageSize;
+		m_NumMips = header.numMips;
+		while ((1u << m_PageShift) < m_PageSize)
+			++m_PageShift;
+
+		for (uint32_t mip{ 0 }; mip < m_NumMips; ++mip)
+		{
+			const uint32_t mipWidth{ std::max(1u, m_Width >> mip) };
+			const uint32_t mipHeight{ std::max(1u, m_Height >> mip) };
+			const uint32_t pagesX{ (mipWidth + m_PageSize - 1) / m_PageSize };
+			const uint32_t pagesY{ (mipHeight + m_PageSize - 1) / m_PageSize };
+
+			m_MipWidths.push_back(mipWidth);
+			m_MipHeights.push_back(mipHeight);
+			m_MipPagesX.push_back(pagesX);
+			m_MipPageOffsets.push_back(m_NumPages);
+			m_NumPages += pagesX * pagesY;
+		}
+
+		m_PageTable.assign(m_NumPages, m_NotResident);
+		m_pFeedback = std::make_unique<std::atomic<uint8_t>[]>(m_NumPages);
+
+		// The coarsest mip is a single page and always resident, sampling can always fall back to it.
+		// A texture that fits in one page (or a budget of one) only has that pinned slot and never streams
+		const uint32_t numSlots{ std::max(1u, std::min(residentPageBudget, m_NumPages)) };
+		m_PagePool.resize(static_cast<size_t>(numSlots) * m_PageSize * m_PageSize);
+		m_SlotPages.assign(numSlots, m_NotResident);
+		m_SlotLastUsed.assign(numSlots, 0);
+
+		LoadPage(m_NumPages - 1, 0);
+	}
+
+	uint32_t VirtualTexture::Sample(const Vector2& uv, float uvLod) const
+	{
+		const float u{ std::clamp(uv.x, 0.f, 1.f) };
+		const float v{ std::clamp(uv.y, 0.f, 1.f) };
+
+		// Mip that gives roughly one texel per pixel
+		const float lod{ uvLod + std::log2f(static_cast<float>(std::max(m_Width, m_Height))) };
+		uint32_t mip{ static_cast<uint32_t>(std::clamp(lod, 0.f, static_cast<float>(m_NumMips - 1))) };
+
+		bool isRequested{ false };
+		while (true)
+		{
+			const uint32_t x{ std::min(static_cast<uint32_t>(u * m_MipWidths[mip]), m_MipWidths[mip] - 1) };
+			const uint32_t y{ std::min(static_cast<uint32_t>(v * m_MipHeights[mip]), m_MipHeights[mip] - 1) };
+			const uint32_t pageIndex{ GetPageIndex(mip, x >> m_PageShift, y >> m_PageShift) };
+
+			// Record the page we actually wanted, not the fallback
+			if (!isRequested)
+			{
+				m_pFeedback[pageIndex].store(1, std::memory_order_relaxed);
+				isRequested = true;
+			}
+
+			const int32_t slot{ m_PageTable[pageIndex] };
+			if (slot != m_NotResident)
+			{
+				const uint32_t localX{ x & (m_PageSize - 1) };
+				const uint32_t localY{ y & (m_PageSize - 1) };
+				return m_PagePool[(static_cast<size_t>(slot) << (m_PageShift * 2)) + (localY << m_PageShift) + localX];
+			}
+
+			++mip;
+		}
+	}
+
+	void VirtualTexture::Update(uint64_t frameIndex)
+	{
+		if (!IsValid())
+			return;
+
+		// Only the pinned slot, there is nothing to evict, the requests just get cleared
+		const bool canStream{ m_SlotPages.size() > 1 };
+
+		std::vector<uint32_t> requestedPages{};
+		for (uint32_t pageIndex{ 0 }; pageIndex < m_NumPages; ++pageIndex)
+		{
+			if (!m_pFeedback[pageIndex].exchange(0, std::memory_order_relaxed))
+				continue;
+
+			const int32_t slot{ m_PageTable[pageIndex] };
+			if (slot != m_NotResident)
+				m_SlotLastUsed[slot] = frameIndex;
+			else if (canStream)
+				requestedPages.push_back(pageIndex);
+		}
+
+		// Coarse pages first, they cover the most screen space and give the fallbacks for the finer ones
+		std::sort(requestedPages.begin(), requestedPages.end(), std::greater<uint32_t>());
+		if (requestedPages.size() > m_MaxPageLoadsPerUpdate)
+			requestedPages.resize(m_MaxPageLoadsPerUpdate);
+
+		for (const uint32_t pageIndex : requestedPages)
+		{
+			// Least recently used slot, the pinned slot 0 is never evicted
+			uint32_t victimSlot{ 1 };
+			for (uint32_t slot{ 2 }; slot < m_SlotPages.size(); ++slot)
+			{
+				if (m_SlotLastUsed[slot] < m_SlotLastUsed[victimSlot])
+					victimSlot = slot;
+			}
+
+			// Everything resident was used this frame, the budget is too small to load more
+			if (m_SlotPages[victimSlot] != m_NotResident && m_SlotLastUsed[victimSlot] == frameIndex)
+				break;
+
+			if (m_SlotPages[victimSlot] != m_NotResident)
+				m_PageTable[m_SlotPages[victimSlot]] = m_NotResident;
+
+			LoadPage(pageIndex, victimSlot);
+			m_SlotLastUsed[victimSlot] = frameIndex;
+		}
+	}
+
+	void VirtualTexture::LoadPage(uint32_t pageIndex, uint32_t slot)
+	{
+		const size_t pageTexels{ static_cast<size_t>(m_PageSize) * m_PageSize };
+		m_File.clear();
+		m_File.seekg(sizeof(Header) + pageIndex * pageTexels * sizeof(uint32_t));
+		m_File.read(reinterpret_cast<char*>(&m_PagePool[slot * pageTexels]), pageTexels * sizeof(uint32_t));
+
+		m_SlotPages[slot] = static_cast<int32_t>(pageIndex);
+		m_PageTable[pageIndex] = static_cast<int32_t>(slot);
+	}
+
+	SDL_Surface* VirtualTexture::CreateCoarsestMipSurface() const
+	{
+		const uint32_t mip{ m_NumMips - 1 };
+		SDL_Surface* pSurface{ SDL_CreateRGBSurfaceWithFormat(0, m_MipWidths[mip], m_MipHeights[mip], 32, SDL_PIXELFORMAT_ABGR8888) };
+		if (!IsValid())
+			return pSurface;
+
+		for (uint32_t y{ 0 }; y < m_MipHeights[mip]; ++y)
+		{
+			uint32_t* pRow{ reinterpret_cast<uint32_t*>(static_cast<uint8_t*>(pSurface->pixels) + y * pSurface->pitch) };
+			std::copy_n(&m_PagePool[y * m_PageSize], m_MipWidths[mip], pRow);
+		}
+		return pSurface;
+	}
+
+	bool VirtualTexture::WriteTiledFile(SDL_Surface* pSurface, const std::string& tiledPath, uint32_t pageSize)
+	{
+		// Pages are addressed with shifts and masks
+		if (!pSurface || pageSize == 0 || (pageSize & (pageSize - 1)) != 0)
+			return false;
+
+		SDL_Surface* pConverted{ SDL_ConvertSurfaceFormat(pSurface, SDL_PIXELFORMAT_ABGR8888, 0) };
+		if (!pConverted)
+			return false;
+
+		// Mip 0 with tightly packed rows
+		uint32_t mipWidth{ static_cast<uint32_t>(pConverted->w) };
+		uint32_t mipHeight{ static_cast<uint32_t>(pConverted->h) };
+		std::vector<uint32_t> mipTexels(static_cast<size_t>(mipWidth) * mipHeight);
+		for (uint32_t y{ 0 }; y < mipHeight; ++y)
+		{
+			const uint32_t* pRow{ reinterpret_cast<const uint32_t*>(static_cast<const uint8_t*>(pConverted->pixels) + y * pConverted->pitch) };
+			std::copy_n(pRow, mipWidth, &mipTexels[static_cast<size_t>(y) * mipWidth]);
+		}
+		SDL_FreeSurface(pConverted);
+
+		// Mips down to the first level that fits a single page
+		uint32_t numMips{ 1 };
+		while ((std::max(1u, mipWidth >> (numMips - 1)) > pageSize) || (std::max(1u, mipHeight >> (numMips - 1)) > pageSize))
+			++numMips;
+
+		std::ofstream file{ tiledPath, std::ios::binary };
+		if (!file)
+			return false;
+
+		const Header header{ m_Magic, m_Version, mipWidth, mipHeight, pageSize, numMips };
+		file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+
+		std::vector<uint32_t> page(static_cast<size_t>(pageSize) * pageSize);
+		for (uint32_t mip{ 0 }; mip < numMips; ++mip)
+		{
+			// Pages are stored row by row, edge pages replicate the last texel
+			for (uint32_t pageY{ 0 }; pageY * pageSize < mipHeight; ++pageY)
+			{
+				for (uint32_t pageX{ 0 }; pageX * pageSize < mipWidth; ++pageX)
+				{
+					for (uint32_t y{ 0 }; y < pageSize; ++y)
+					{
+						const uint32_t srcY{ std::min(pageY * pageSize + y, mipHeight - 1) };
+						for (uint32_t x{ 0 }; x < pageSize; ++x)
+						{
+							const uint32_t srcX{ std::min(pageX * pageSize + x, mipWidth - 1) };
+							page[y * pageSize + x] = mipTexels[static_cast<size_t>(srcY) * mipWidth + srcX];
+						}
+					}
+					file.write(reinterpret_cast<const char*>(page.data()), page.size() * sizeof(uint32_t));
+				}
+			}
+
+			// 2x2 box filter into the next mip
+			const uint32_t nextWidth{ std::max(1u, mipWidth / 2) };
+			const uint32_t nextHeight{ std::max(1u, mipHeight / 2) };
+			std::vector<uint32_t> nextTexels(static_cast<size_t>(nextWidth) * nextHeight);
+			for (uint32_t y{ 0 }; y < nextHeight; ++y)
+			{
+				for (uint32_t x{ 0 }; x < nextWidth; ++x)
+				{
+					const uint32_t x0{ std::min(x * 2, mipWidth - 1) }, x1{ std::min(x * 2 + 1, mipWidth - 1) };
+					const uint32_t y0{ std::min(y * 2, mipHeight - 1) }, y1{ std::min(y * 2 + 1, mipHeight - 1) };
+					const uint32_t texels[4]
+					{
+						mipTexels[static_cast<size_t>(y0) * mipWidth + x0], mipTexels[static_cast<size_t>(y0) * mipWidth + x1],
+						mipTexels[static_cast<size_t>(y1) * mipWidth + x0], mipTexels[static_cast<size_t>(y1) * mipWidth + x1]
+					};
+
+					uint32_t averaged{ 0 };
+					for (uint32_t channel{ 0 }; channel < 32; channel += 8)
+					{
+						uint32_t sum{ 2 };
+						for (const uint32_t texel : texels)
+							sum += (texel >> channel) & 0xFF;
+						averaged |= (sum / 4) << channel;
+					}
+					nextTexels[static_cast<size_t>(y) * nextWidth + x] = averaged;
+				}
+			}
+
+			mipTexels = std::move(nextTexels);
+			mipWidth = nextWidth;
+			mipHeight = nextHeight;
+		}
+
+		return static_cast<bool>(file);
+	}
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <atomic>
+#include <fstream>
+#include <string>
+
+namespace dae
+{
+	// Software virtual texture backed by a tiled file on disk.
+	// Every mip level is split into fixed-size pages, only the pages the rasterizer asked for are kept in memory.
+	// Sampling never blocks: a missing page falls back to the closest coarser resident mip and gets requested
+	// through the feedback buffer, the requested pages are streamed in by Update between frames.
+	class VirtualTexture final
+	{
+	public:
+		// The budget includes the pinned coarsest mip page, so a budget of 1 never streams anything in
+		VirtualTexture(const std::string& tiledPath, uint32_t residentPageBudget = 32);
+		~VirtualTexture() = default;
+
+		VirtualTexture(const VirtualTexture&) = delete;
+		VirtualTexture(VirtualTexture&&) noexcept = delete;
+		VirtualTexture& operator=(const VirtualTexture&) = delete;
+		VirtualTexture& operator=(VirtualTexture&&) noexcept = delete;
+
+		bool IsValid() const { return m_NumMips > 0; }
+
+		// Returns the R8G8B8A8 texel, uvLod is the log2 of the uv extent covered by one pixel
+		uint32_t Sample(const Vector2& uv, float uvLod) const;
+
+		// Streams in the pages recorded by the feedback of the last frame, evicting the least recently used ones
+		void Update(uint64_t frameIndex);
+
+		// Coarsest mip level, always resident
+		SDL_Surface* CreateCoarsestMipSurface() const;
+
+		uint32_t GetWidth() const { return m_Width; }
+		uint32_t GetHeight() const { return m_Height; }
+		size_t GetMemorySize() const { return m_PagePool.size() * sizeof(uint32_t); }
+
+		// Writes the surface as a mip-mapped, tiled file that can be opened as a virtual texture
+		static bool WriteTiledFile(SDL_Surface* pSurface, const std::string& tiledPath, uint32_t pageSize = 128);
+
+	private:
+		struct Header
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint32_t width;
+			uint32_t height;
+			uint32_t pageSize;
+			uint32_t numMips;
+		};
+
+		static constexpr uint32_t m_Magic{ 0x58455456 }; // "VTEX"
+		static constexpr uint32_t m_Version{ 1 };
+		static constexpr uint32_t m_MaxPageLoadsPerUpdate{ 16 };
+		static constexpr int32_t m_NotResident{ -1 };
+
+		uint32_t GetPageIndex(uint32_t mip, uint32_t pageX, uint32_t pageY) const { return m_MipPageOffsets[mip] + pageY * m_MipPagesX[mip] + pageX; }
+		void LoadPage(uint32_t pageIndex, uint32_t slot);
+
+		std::ifstream m_File{};
+
+		uint32_t m_Width{};
+		uint32_t m_Height{};
+		uint32_t m_PageSize{};
+		uint32_t m_PageShift{};
+		uint32_t m_NumMips{};
+		uint32_t m_NumPages{};
+
+		std::vector<uint32_t> m_MipWidths{};
+		std::vector<uint32_t> m_MipHeights{};
+		std::vector<uint32_t> m_MipPagesX{};
+		std::vector<uint32_t> m_MipPageOffsets{};
+
+		// Page table: virtual page -> slot in the page pool
+		std::vector<int32_t> m_PageTable{};
+
+		// Page pool: resident texels, slot 0 holds the pinned coarsest mip
+		std::vector<uint32_t> m_PagePool{};
+		std::vector<int32_t> m_SlotPages{};
+		std::vector<uint64_t> m_SlotLastUsed{};
+
+		// Written by the rasterizer threads while sampling, one flag per virtual page
+		std::unique_ptr<std::atomic<uint8_t>[]> m_pFeedback{};
+	};
+}
@@ -7,40 +7,167 @@
 #undef main
 #include "Renderer.h"
 #include "Scene.h"
+#include "JobSystem.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
 
 using namespace dae;
 
+struct Options
+{
+	bool isHeadless{ false };
+	int width{ 640 };
+	int height{ 480 };
+	uint32_t numFrames{ 1 };
+	std::string outputPath{};
+	uint32_t numWorkers{ 0 }; // 0 = one per hardware thread
+	bool pinWorkers{ false };
+	bool useVirtualTexturing{ false };
+};
+
+void PrintUsage()
+{
+	std::cout
+		<< "Usage: Dual_Rasterizer [options]\n"
+		<< "  --width <px>          Window (or headless frame) width, default 640\n"
+		<< "  --height <px>         Window (or headless frame) height, default 480\n"
+		<< "  --workers <n>         Job system worker threads, default one per hardware thread\n"
+		<< "  --pin-workers         Pins every worker to its own hardware thread, spread over all processor groups\n"
+		<< "  --virtual-texturing   Streams the vehicle textures page by page for the software rasterizer\n"
+		<< "  --headless            Software rendering without a window or GPU, exits after the last frame\n"
+		<< "  --frames <n>          Frames to render headless, default 1\n"
+		<< "  --output <file>       Saves the last headless frame as a BMP\n";
+}
+
+bool ParseOptions(int argc, char* args[], Options& options)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string argument{ args[i] };
+		const bool hasValue{ i + 1 < argc };
+
+		if (argument == "--headless") options.isHeadless = true;
+		else if (argument == "--virtual-texturing") options.useVirtualTexturing = true;
+		else if (argument == "--pin-workers") options.pinWorkers = true;
+		else if (argument == "--width" && hasValue) options.width = std::atoi(args[++i]);
+		else if (argument == "--height" && hasValue) options.height = std::atoi(args[++i]);
+		else if (argument == "--workers" && hasValue) options.numWorkers = static_cast<uint32_t>(std::max(std::atoi(args[++i]), 0));
+		else if (argument == "--frames" && hasValue) options.numFrames = static_cast<uint32_t>(std::max(std::atoi(args[++i]), 0));
+		else if (argument == "--output" && hasValue) options.outputPath = args[++i];
+		else return false;
+	}
+	return options.width > 0 && options.height > 0 && options.numFrames > 0;
+}
+
 void ShutDown(SDL_Window* pWindow)
 {
 	SDL_DestroyWindow(pWindow);
 	SDL_Quit();
 }
 
+// Renders a fixed number of software frames into an offscreen buffer, for machines without a display or GPU
+int RunHeadless(const Options& options, JobSystem* pJobSystem)
+{
+	// No video subsystem, surfaces and image loading work without it
+	SDL_Init(0);
+
+	const auto pTimer = new Timer();
+	const auto pRenderer = new Renderer(options.width, options.height, pJobSystem);
+	// The scene resources can't be created without a device
+	if (!pRenderer->GetDevice())
+	{
+		std::cout << "ERROR headless rendering needs a D3D11 (WARP) device!\n";
+		delete pRenderer;
+		delete pTimer;
+		SDL_Quit();
+		return 1;
+	}
+
+	const auto pScene = new ReferenceScene(pJobSystem);
+	pScene->SetUseVirtualTexturing(options.useVirtualTexturing);
+	pScene->Initialize(pRenderer->GetDevice());
+	pScene->SetRenderType(RenderType::Software);
+
+	// Every frame gets the final textures, not the placeholders
+	while (pScene->IsLoading())
+	{
+		pScene->UpdateResources(pRenderer->GetDevice());
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	pTimer->Start();
+	for (uint32_t frame = 0; frame < options.numFrames; ++frame)
+	{
+		pScene->Update(pTimer, pRenderer->GetDevice());
+
+		pRenderer->WaitForFrame();
+		pScene->UpdateResources(pRenderer->GetDevice());
+		pRenderer->Render(pScene);
+
+		pTimer->Update();
+		pRenderer->UpdateResolutionScale(pTimer->GetElapsed(), pScene->GetRenderInfo());
+	}
+	pRenderer->WaitForFrame();
+	pTimer->Update();
+	pTimer->Stop();
+
+	std::cout << "[HEADLESS] Rendered " << options.numFrames << " frames at " << options.width << 'x' << options.height
+		<< " in " << pTimer->GetTotal() << "s\n";
+
+	bool isSaved{ true };
+	if (!options.outputPath.empty())
+	{
+		isSaved = pRenderer->SaveFrame(options.outputPath);
+		if (isSaved) std::cout << "[HEADLESS] Saved last frame to " << options.outputPath << '\n';
+	}
+
+	delete pRenderer;
+	delete pScene;
+	delete pTimer;
+
+	SDL_Quit();
+	return isSaved ? 0 : 1;
+}
+
 int main(int argc, char* args[])
 {
-	//Unreferenced parameters
-	(void)argc;
-	(void)args;
+	Options options{};
+	if (!ParseOptions(argc, args, options))
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	const auto pJobSystem = new JobSystem(options.numWorkers, options.pinWorkers);
+	if (options.isHeadless)
+	{
+		const int result{ RunHeadless(options, pJobSystem) };
+		delete pJobSystem;
+		return result;
+	}
 
 	//Create window + surfaces
 	SDL_Init(SDL_INIT_VIDEO);
 
-	const uint32_t width = 640;
-	const uint32_t height = 480;
-
 	SDL_Window* pWindow = SDL_CreateWindow(
 		"Dual Rasterizer - Belmans Jef - 2DAE15N",
 		SDL_WINDOWPOS_UNDEFINED,
 		SDL_WINDOWPOS_UNDEFINED,
-		width, height, 0);
+		options.width, options.height, 0);
 
 	if (!pWindow)
+	{
+		delete pJobSystem;
 		return 1;
+	}
 
 	//Initialize "framework"
 	const auto pTimer = new Timer();
-	const auto pRenderer = new Renderer(pWindow);
-	const auto pScene = new ReferenceScene();
+	const auto pRenderer = new Renderer(pWindow, pJobSystem);
+	const auto pScene = new ReferenceScene(pJobSystem);
+	pScene->SetUseVirtualTexturing(options.useVirtualTexturing);
 	pScene->Initialize(pRenderer->GetDevice());
 
 	//Start loop
@@ -66,19 +193,28 @@ int main(int argc, char* args[])
 		}
 
 		//--------- Update ---------
+		// Runs alongside the software frame still in flight, which only reads its own copy of the scene
 		pScene->Update(pTimer, pRenderer->GetDevice());
 
 		//--------- Render ---------
+		pRenderer->WaitForFrame();
+		pScene->UpdateResources(pRenderer->GetDevice());
 		pRenderer->Render(pScene);
 
 		//--------- Timer ---------
 		pTimer->Update();
+		pRenderer->UpdateResolutionScale(pTimer->GetElapsed(), pScene->GetRenderInfo());
 		printTimer += pTimer->GetElapsed();
 		if (printTimer >= 1.f)
 		{
 			printTimer = 0.f;
 			if(pScene->GetRenderInfo().showFPS)
-				std::cout << "dFPS: " << pTimer->GetdFPS() << std::endl;
+			{
+				std::cout << "dFPS: " << pTimer->GetdFPS();
+				if (pScene->GetRenderInfo().useDynamicResolution)
+					std::cout << " (render scale: " << pRenderer->GetRenderScale() << ")";
+				std::cout << std::endl;
+			}
 		}
 	}
 	pTimer->Stop();
@@ -86,6 +222,7 @@ int main(int argc, char* args[])
 	//Shutdown "framework"
 	delete pRenderer;
 	delete pScene;
+	delete pJobSystem;
 	delete pTimer;
 
 	ShutDown(pWindow);